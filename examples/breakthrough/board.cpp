@@ -15,7 +15,7 @@ namespace {
     struct BT_HashIndex {
         constexpr size_t operator()(Pawn p, Square s)
         {
-            return (1 + to_int(color_of(p))) * to_int(s);
+            return to_int(color_of(p)) * to_int(Square::Nb) + to_int(s);
         }
     };
 
@@ -23,7 +23,7 @@ namespace {
 
     zobrist::KeyTable<BT_HashIndex, Position::key_type, BT_NKeys> KTable(1); // Reserve one bit For the player's turn.
 
-    Rand::Util<Position::key_type> rand_util {};
+    thread_local Rand::Util<Position::key_type> rand_util {};
 
     std::array<std::vector<std::pair<Square, Pawn>>, to_int(Color::Nb)> initial_board()
     {
@@ -45,7 +45,7 @@ namespace {
         Bitboards<Color> ret;
 
         ret[0] = 0xFFFF;
-        ret[1] = 0xFFFF800000000000;
+        ret[1] = 0xFFFF000000000000;
         return ret;
     }
 
@@ -54,9 +54,11 @@ namespace {
 Position::key_type Position::compute_key() const
 {
     key_type key = to_int(m_side_to_move);
-    for (const auto& [s, p] : pawns(m_side_to_move)) {
-        if (p != Pawn::None)
-            key ^= KTable(p, s);
+    for (const auto& color_pawns : m_pawns) {
+        for (const auto& [s, p] : color_pawns) {
+            if (p != Pawn::None)
+                key ^= KTable(p, s);
+        }
     }
 
     return key;
@@ -94,6 +96,12 @@ const std::vector<Move>& Position::valid_actions() const
 }
 
 bool Position::apply_action(Move m)
+{
+    undo_type undo;
+    return apply_action(m, undo);
+}
+
+bool Position::apply_action(Move m, undo_type& undo)
 {
     bool ret = is_valid(m);
 
@@ -105,10 +113,14 @@ bool Position::apply_action(Move m)
     Bitboard to_bb = square_bb(to);
 
     auto& opp_color_bb = color_bb(~m_side_to_move);
+    undo.captured = opp_color_bb & to_bb;
+    // (The last move is stored for the side to move after the move.)
+    undo.last_played = m_side_to_move == Color::White ? last_played_b : last_played_w;
     // If Capture
     if (opp_color_bb & to_bb) {
         remove_piece(make_pawn(~m_side_to_move), to);
         opp_color_bb &= ~to_bb;
+        m_key ^= KTable(make_pawn(~m_side_to_move), to);
     }
 
     Pawn my_pawn = make_pawn(m_side_to_move);
@@ -130,18 +142,56 @@ bool Position::apply_action(Move m)
     return ret;
 }
 
+void Position::undo_action(Move m, const undo_type& undo)
+{
+    Square from = from_sq(m);
+    Square to = to_sq(m);
+
+    m_side_to_move = ~m_side_to_move;
+    m_key ^= 1;
+
+    Pawn my_pawn = make_pawn(m_side_to_move);
+
+    move_pawn(my_pawn, to, from);
+
+    m_key ^= KTable(my_pawn, to);
+    m_key ^= KTable(my_pawn, from);
+
+    if (undo.captured) {
+        put_piece(make_pawn(~m_side_to_move), to);
+        m_key ^= KTable(make_pawn(~m_side_to_move), to);
+    }
+
+    if (m_side_to_move == Color::White) {
+        last_played_b = undo.last_played;
+    } else {
+        last_played_w = undo.last_played;
+    }
+}
+
 /**
- * Same as valid_actions() but we iterate over the pawns in a random order
- * and we break the search as soon as a valid move is found (then we apply it).
+ * Apply a move chosen by random_action().
  */
 Move Position::apply_random_action()
+{
+    Move m = random_action();
+    if (m != Move::Null)
+        apply_action(m);
+    return m;
+}
+
+/**
+ * Same as valid_actions() but we iterate over the pawns in a random order
+ * and we break the search as soon as a pawn with a valid move is found.
+ */
+Move Position::random_action() const
 {
     m_move_list.clear();
-    auto& my_pawns = pawns(m_side_to_move);
+    const auto& my_pawns = pawns(m_side_to_move);
     auto _shuffle = rand_util.gen_ordering<Max_w_pawns>(0, my_pawns.size());
 
     for (auto it = _shuffle.begin(); it != _shuffle.end(); ++it) {
-        auto& [s, p] = my_pawns[*it];
+        const auto& [s, p] = my_pawns[*it];
 
         Bitboard legal_bb = legal_moves_bb(m_side_to_move, s);
 
@@ -150,38 +200,13 @@ Move Position::apply_random_action()
         if (valid_bb == 0)
             continue;
 
-        while (1) {
+        while (valid_bb != 0) {
             Square to = lsb(valid_bb);
-            valid_bb ^= square_bb(to);
             m_move_list.push_back(make_move(s, to));
-
-            if (valid_bb == 0)
-                break;
-        }
-
-        Move m = rand_util.choose(m_move_list);
-
-        auto& opp_color_bb = color_bb(~m_side_to_move);
-        Bitboard from_bb = square_bb(s);
-        Square& to = (s = to_sq(m));
-
-        m_byColorBB[to_int(m_side_to_move)] ^= (from_bb ^ square_bb(to));
-
-        // If Capture
-        if (opp_color_bb & square_bb(to)) {
-            remove_piece(make_pawn(~m_side_to_move), to);
-            opp_color_bb &= ~square_bb(to);
-        }
-
-        if (m_side_to_move == Color::White) {
-            last_played_w = to;
-        } else {
-            last_played_b = to;
+            valid_bb ^= square_bb(to);
         }
 
-        m_side_to_move = ~m_side_to_move;
-
-        return m;
+        return rand_util.choose(m_move_list);
     }
 
     return Move::Null;
@@ -21,17 +21,28 @@ public:
     using action_type = Move;
     using reward_type = double;
     using player_type = Color;
+    /** The edges hold the statistics of RAVE (see `--rave`). */
+    static constexpr bool amaf_statistics = true;
 
     using Move_list = std::array<Move, Max_w_pawns>;
 
+    /** What `undo_action()` needs to know about a move, beyond the move itself. */
+    struct undo_type {
+        bool captured;
+        Square last_played;
+    };
+
     Position();
 
     key_type constexpr key() const;
 
     const std::vector<Move>& valid_actions() const;
     bool apply_action(Move);
+    bool apply_action(Move, undo_type&);
+    void undo_action(Move, const undo_type&);
     Move apply_random_action();
     Move apply_random_action_gen();
+    Move random_action() const;
 
     bool constexpr is_terminal() const;
     reward_type constexpr evaluate(Move) const;
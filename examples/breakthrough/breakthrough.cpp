@@ -3,13 +3,16 @@
 #include "types.h"
 
 #include <cmath>
+#include <cstdlib>
 #include <iostream>
+#include <optional>
 #include <random>
 #include <string>
 #include <thread>
 
 #include "mcts.h"
 #include "policies.h"
+#include "time_manager.h"
 #include "utils/agent_random.h"
 
 void progress_bar(int cnt, int n_games)
@@ -22,6 +25,16 @@ void progress_bar(int cnt, int n_games)
               << std::endl;
 }
 
+std::optional<mcts::Parallelization> parse_parallelization(const std::string& mode)
+{
+    if (mode == "root")
+        return mcts::Parallelization::Root;
+    if (mode == "tree")
+        return mcts::Parallelization::Tree;
+    if (mode == "leaf")
+        return mcts::Parallelization::Leaf;
+    return std::nullopt;
+}
 
 
 using namespace BT;
@@ -29,6 +42,14 @@ using namespace BT;
 template<size_t N>
 struct TimeCutoff_UCB_Func
 {
+    // The constant exploration term past the cutoff doesn't change the argmax.
+    double exploration_weight(double expl_cst, unsigned int n_parent_visits) const
+    {
+        return n_parent_visits < N
+            ? expl_cst * mcts::selection::sqrt_log_visits(n_parent_visits)
+            : 0.0;
+    }
+
     auto operator()(double expl_cst, unsigned int n_parent_visits)
     {
         return [expl_cst, n_parent_visits]<typename EdgeT>(const EdgeT& edge)
@@ -50,12 +71,35 @@ struct configure_agent {
     int n_iterations = 500;
     double max_time = 0;
     double expl_cst = 1.0;
+    int n_threads = 1;
+    // Search during the opponent's turns.
+    bool ponder = false;
+    // How the threads share the work (see `mcts::Parallelization`).
+    mcts::Parallelization parallelization = mcts::Parallelization::Root;
+    // When positive, the game clock and increment (in ms) which replace
+    // the iteration and time budgets.
+    int game_time = 0;
+    int increment = 0;
+    // Prove the won and lost lines (MCTS-Solver).
+    bool solver = false;
+    // Share the values of the transpositions between all their parents.
+    bool dag_values = false;
+    // Blend in the all-moves-as-first values of the playouts (RAVE).
+    bool rave = false;
+    // When positive, open the children of the nodes one at a time (progressive widening).
+    double widening = 0.0;
 
     void operator()(Agent& mcts)
     {
-        mcts.set_max_iterations(n_iterations);
+        mcts.set_max_iterations(game_time > 0 ? 0 : n_iterations);
         mcts.set_max_time(max_time);
         mcts.set_exploration_constant(expl_cst);
+        mcts.set_n_threads(n_threads);
+        mcts.set_parallelization(parallelization);
+        mcts.set_solver(solver);
+        mcts.set_dag_values(dag_values);
+        mcts.set_rave(rave);
+        mcts.set_widening(widening);
         mcts.set_backpropagation_strategy(
             Backprop::avg_best_value);
         mcts.set_n_players(
@@ -101,6 +145,40 @@ int main(int argc, char* argv[])
     conf2.n_iterations = n_iters;
     conf2.max_time = 0;
 
+    // The search features are off unless asked for.
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        std::optional<mcts::Parallelization> mode;
+        if (arg == "--solver") {
+            conf1.solver = true;
+        } else if (arg == "--dag-values") {
+            conf1.dag_values = true;
+        } else if (arg == "--rave") {
+            conf1.rave = true;
+        } else if (arg == "--widening" && i + 1 < argc) {
+            conf1.widening = std::stod(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            conf1.n_threads = std::stoi(argv[++i]);
+        } else if (arg == "--parallelization" && i + 1 < argc
+                   && (mode = parse_parallelization(argv[i + 1]))) {
+            conf1.parallelization = *mode;
+            ++i;
+        } else if (arg == "--ponder") {
+            conf1.ponder = true;
+        } else if (arg == "--game-time" && i + 1 < argc) {
+            conf1.game_time = std::stoi(argv[++i]);
+        } else if (arg == "--increment" && i + 1 < argc) {
+            conf1.increment = std::stoi(argv[++i]);
+        } else {
+            std::cerr << "Unknown option: " << arg
+                      << "\nUsage: " << argv[0] << " [--solver] [--dag-values] [--rave] [--widening c]"
+                      << " [--threads n] [--parallelization root|tree|leaf] [--ponder]"
+                      << " [--game-time ms] [--increment ms]"
+                      << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
     std::vector<std::chrono::milliseconds> times;
     std::vector<bool> results;
     utils::Stopwatch sw{};
@@ -119,14 +197,20 @@ int main(int argc, char* argv[])
         Agent_random<Position> rand { pos };
         conf2(rand);
 
+        Time_manager clock(conf1.game_time, conf1.increment);
+
         int depth = 0;
 
         while (!pos.is_terminal())
         {
             if (pos.side_to_move() == p_mcts) {
+                if (conf1.game_time > 0)
+                    clock.configure(mcts);
                 sw.reset_start();
                 move_buf = mcts.best_action();
-                time += sw.get();
+                auto move_time = sw.get();
+                time += move_time;
+                clock.move_played(move_time.count());
             } else {
                 move_buf = rand.best_action();
             }
@@ -154,6 +238,11 @@ int main(int argc, char* argv[])
             rand.apply_root_action(move_buf);
             pos.apply_action(move_buf);
             ++depth;
+
+            // Let the MCTS agent search while the random agent plays.
+            if (conf1.ponder && !pos.is_terminal() && pos.side_to_move() != p_mcts) {
+                mcts.start_ponder();
+            }
         }
 
         bool res = (pos.winner(pos) == p_mcts ? 1 : 0);
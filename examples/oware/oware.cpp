@@ -58,6 +58,24 @@ inline void distribute(std::array<int, 6>& holes,
     }
 }
 
+/** Take back the beads dropped by `distribute()`. */
+inline void undistribute(std::array<int, 6>& holes,
+    int& m,
+    int& n_beads,
+    bool cur_player)
+{
+    int pm = cur_player ? 1 : -1;
+    int end = cur_player ? 6 : -1;
+
+    while (n_beads > 0) {
+        m += pm;
+        if (m == end)
+            break;
+        --holes[m];
+        --n_beads;
+    }
+}
+
 /** Drop a bead in a mancala. */
 inline void feed_mancala(int& mancala, int n_beads = 1)
 {
@@ -209,6 +227,12 @@ bool Board::is_trivial(int action) const
  * is to be consistent with the mcts interface and should be fixed there.)
  */
 bool Board::apply_action(int action)
+{
+    undo_type undo;
+    return apply_action(action, undo);
+}
+
+bool Board::apply_action(int action, undo_type& undo)
 {
     if (is_trivial(action))
         return false;
@@ -219,6 +243,7 @@ bool Board::apply_action(int action)
     auto& player_mancala = player ? man_player1 : man_player2;
 
     int n_beads = pickup_beads(player_holes[action]);
+    undo = undo_type { n_beads, 0, -1, player };
 
     while (n_beads > 0)
     {
@@ -227,11 +252,16 @@ bool Board::apply_action(int action)
         // If we distributed all beads before the player's mancala
         if (n_beads == 0)
         {
+            int mancala_before = player_mancala;
             capture_if_can(
                 player_holes,
                 other_player_holes,
                 player_mancala,
                 action);
+            if (player_mancala != mancala_before) {
+                undo.captured = player_mancala - mancala_before - 1;
+                undo.capture_hole = action;
+            }
             break;
         }
 
@@ -256,26 +286,73 @@ bool Board::apply_action(int action)
     return true;
 }
 
+/**
+ * Walk the path of the beads again, taking them back one at a time.
+ */
+void Board::undo_action(int action, const undo_type& undo)
+{
+    bool player = undo.player;
+    auto& player_holes = player ? player1 : player2;
+    auto& other_player_holes = player ? player2 : player1;
+    auto& player_mancala = player ? man_player1 : man_player2;
+
+    m_player = player;
+
+    // The capture happened last, so it is undone first.
+    if (undo.capture_hole != -1) {
+        player_holes[undo.capture_hole] = 1;
+        other_player_holes[undo.capture_hole] = undo.captured;
+        player_mancala -= undo.captured + 1;
+    }
+
+    int n_beads = undo.n_beads;
+    int m = action;
+
+    while (n_beads > 0)
+    {
+        undistribute(player_holes, m, n_beads, player);
+        if (n_beads == 0)
+            break;
+
+        --player_mancala;
+        --n_beads;
+        if (n_beads == 0)
+            break;
+
+        undistribute(other_player_holes, m, n_beads, !player);
+    }
+
+    player_holes[action] = undo.n_beads;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Random util
 ////////////////////////////////////////////////////////////////////////////////
 namespace {
 
-Rand::Util<int> rand_util {};
+thread_local Rand::Util<int> rand_util {};
 
 } // namespace
 
 int Board::apply_random_action()
 {
-    auto _valid_actions = valid_actions();
-    if (_valid_actions.empty())
+    auto chosen = random_action();
+    if (chosen == -1)
         return -1;
 
-    auto chosen = rand_util.choose(_valid_actions);
     apply_action(chosen);
     return chosen;
 }
 
+int Board::random_action() const
+{
+    auto _valid_actions = valid_actions();
+    if (_valid_actions.empty())
+        return -1;
+
+    return rand_util.choose(_valid_actions);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Hashing of boards
 ////////////////////////////////////////////////////////////////////////////////
@@ -319,7 +396,7 @@ struct Hash_fun {
     }
 };
 
-::zobrist::KeyTable<Hash_fun, int, n_keys> KTable(1);
+::zobrist::KeyTable<Hash_fun, Board::key_type, n_keys> KTable(1);
 
 // Contribution from a hole
 inline Board::key_type key_hole(const Board& b, size_t hole_ndx, bool player)
@@ -13,6 +13,16 @@ public:
     using action_type = int;
     using player_type = bool;
 
+    /**
+     * What `undo_action()` needs to know about an action, beyond the action itself.
+    */
+    struct undo_type {
+        int n_beads;
+        int captured;
+        int capture_hole;
+        bool player;
+    };
+
     Board();
 
     bool is_terminal() const;
@@ -53,6 +63,16 @@ public:
     */
     bool apply_action(int action);
 
+    /**
+     * Same as above, recording what is needed to undo the action.
+    */
+    bool apply_action(int action, undo_type&);
+
+    /**
+     * Take back an action applied with the above method.
+    */
+    void undo_action(int action, const undo_type&);
+
     /**
      * Tries to play a random action for the player whose turn it is.
      *
@@ -61,6 +81,13 @@ public:
     */
     int apply_random_action();
 
+    /**
+     * Choose a random action for the player whose turn it is, without playing it.
+     *
+     * @Note Return -1 in case the game is already over.
+    */
+    int random_action() const;
+
     /**
      * Computes an int that uniquely identifies the board from its state
     */
@@ -2,9 +2,13 @@
 #include "policies.h"
 #include "oware.h"
 #include "oware_mcts.h"
+#include "time_manager.h"
 
 #include <chrono>
+#include <cstdlib>
 #include <iostream>
+#include <optional>
+#include <string>
 
 #include "utils/agent_random.h"
 #include "utils/stopwatch.h"
@@ -54,6 +58,16 @@ void progress_bar(int cnt, int n_games)
               << std::endl;
 }
 
+std::optional<mcts::Parallelization> parse_parallelization(const std::string& mode)
+{
+    if (mode == "root")
+        return mcts::Parallelization::Root;
+    if (mode == "tree")
+        return mcts::Parallelization::Tree;
+    if (mode == "leaf")
+        return mcts::Parallelization::Leaf;
+    return std::nullopt;
+}
 
 
 template<typename Agent>
@@ -64,12 +78,29 @@ struct configure_agent {
     int n_iterations = 2000;
     double max_time = 0;
     double expl_cst = 1.0;
+    int n_threads = 1;
+    // How the threads share the work (see `mcts::Parallelization`).
+    mcts::Parallelization parallelization = mcts::Parallelization::Root;
+    // Search during the opponent's turns.
+    bool ponder = false;
+    // When positive, the game clock and increment (in ms) which replace
+    // the iteration and time budgets.
+    int game_time = 0;
+    int increment = 0;
+    // Share the values of the transpositions between all their parents.
+    bool dag_values = false;
+    // The number of visits of an edge before its node is inserted in the tree.
+    int materialization_threshold = 0;
 
     void operator()(Agent& mcts)
     {
-        mcts.set_max_iterations(n_iterations);
+        mcts.set_max_iterations(game_time > 0 ? 0 : n_iterations);
         mcts.set_max_time(max_time);
         mcts.set_exploration_constant(expl_cst);
+        mcts.set_n_threads(n_threads);
+        mcts.set_parallelization(parallelization);
+        mcts.set_dag_values(dag_values);
+        mcts.set_materialization_threshold(materialization_threshold);
         mcts.set_backpropagation_strategy(
             Backprop::avg_best_value);
         mcts.set_n_players(
@@ -123,6 +154,11 @@ void make_play(int n_games,
     utils::Stopwatch sw1, sw2;
     std::chrono::milliseconds time1, time2;
     time1 = time2 = std::chrono::milliseconds::zero();
+    // Tree reuse of agent1 between moves (if it is an mcts agent).
+    size_t n_kept = 0, n_freed = 0, n_moves = 0;
+    std::chrono::microseconds reuse_time = std::chrono::microseconds::zero();
+    // Iterations agent1 ran while pondering.
+    size_t n_pondered = 0, n_ponders = 0;
 
     for (int game = 0; game < 2 * n_games; ++game) {
         progress_bar(game, 2 * n_games);
@@ -136,15 +172,29 @@ void make_play(int n_games,
         Agent2 agent2(b);
         conf2(agent2);
 
+        std::optional<mcts::Time_manager> clock1;
+        if constexpr (requires { conf1.game_time; }) {
+            if (conf1.game_time > 0) {
+                clock1.emplace(conf1.game_time, conf1.increment);
+            }
+        }
+
         action_type action_buf{};
 
         while (!b.is_terminal())
         {
             if (b.side_to_move() == agent1_player)
             {
+                if constexpr (requires { conf1.game_time; }) {
+                    if (clock1)
+                        clock1->configure(agent1);
+                }
                 sw1.reset_start();
                 action_buf = agent1.best_action();
-                time1 += sw1.get();
+                auto move_time = sw1.get();
+                time1 += move_time;
+                if (clock1)
+                    clock1->move_played(move_time.count());
             }
             else
             {
@@ -159,9 +209,33 @@ void make_play(int n_games,
                       << "\nChosen action: " << action_buf
                       << std::endl;
 #endif
+            bool pondered = false;
+            if constexpr (requires { agent1.pondering(); }) {
+                pondered = agent1.pondering();
+            }
+
             agent1.apply_root_action(action_buf);
             agent2.apply_root_action(action_buf);
             b.apply_action(action_buf);
+
+            // Let agent1 search while agent2 thinks.
+            if constexpr (requires { agent1.start_ponder(); conf1.ponder; }) {
+                if (pondered) {
+                    n_pondered += agent1.get_ponder_iterations();
+                    ++n_ponders;
+                }
+                if (conf1.ponder && !b.is_terminal() && b.side_to_move() != agent1_player) {
+                    agent1.start_ponder();
+                }
+            }
+        }
+
+        if constexpr (requires { agent1.get_reuse_stats(); }) {
+            const auto& stats = agent1.get_reuse_stats();
+            n_kept += stats.n_kept;
+            n_freed += stats.n_freed;
+            n_moves += stats.n_moves;
+            reuse_time += stats.time;
         }
 
         // Figure out the result from the point of view of the mcts agent
@@ -222,10 +296,23 @@ void make_play(int n_games,
               << std::setprecision(4)
               << time2.count() / (2.0 * n_games) << "ms"
               << std::endl;
+
+    if (n_moves > 0) {
+        std::cerr << "\nTree reuse for agent1 over " << n_moves << " moves:"
+                  << "\nAverage nodes kept per move: " << n_kept / n_moves
+                  << "\nAverage nodes freed per move: " << n_freed / n_moves
+                  << "\nAverage time per move: " << reuse_time.count() / n_moves << "us"
+                  << std::endl;
+    }
+    if (n_ponders > 0) {
+        std::cerr << "\nAverage iterations pondered by agent1 per opponent move: "
+                  << n_pondered / n_ponders
+                  << std::endl;
+    }
 }
 
 
-int main()
+int main(int argc, char* argv[])
 {
     using namespace oware;
 
@@ -282,6 +369,36 @@ int main()
     conf2.n_iterations = 12;
     conf1.max_time = conf2.max_time = 0;
 
+    // The search features are off unless asked for.
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        std::optional<mcts::Parallelization> mode;
+        if (arg == "--dag-values") {
+            conf1.dag_values = true;
+        } else if (arg == "--threads" && i + 1 < argc) {
+            conf1.n_threads = std::stoi(argv[++i]);
+        } else if (arg == "--parallelization" && i + 1 < argc
+                   && (mode = parse_parallelization(argv[i + 1]))) {
+            conf1.parallelization = *mode;
+            ++i;
+        } else if (arg == "--materialization-threshold" && i + 1 < argc) {
+            conf1.materialization_threshold = std::stoi(argv[++i]);
+        } else if (arg == "--ponder") {
+            conf1.ponder = true;
+        } else if (arg == "--game-time" && i + 1 < argc) {
+            conf1.game_time = std::stoi(argv[++i]);
+        } else if (arg == "--increment" && i + 1 < argc) {
+            conf1.increment = std::stoi(argv[++i]);
+        } else {
+            std::cerr << "Unknown option: " << arg
+                      << "\nUsage: " << argv[0] << " [--dag-values] [--materialization-threshold k]"
+                      << " [--threads n] [--parallelization root|tree|leaf] [--ponder]"
+                      << " [--game-time ms] [--increment ms]"
+                      << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
     std::cout << "\n********** "
               << agents[1] << " vs " << agents[0]
               << " **********\n\n"
@@ -16,19 +16,25 @@ Oware_Playout_Func::Oware_Playout_Func(Board& _board)
 }
 
 int Oware_Playout_Func::operator()()
+{
+    int hole_ndx = choose();
+    if (hole_ndx != -1)
+        board.apply_action(hole_ndx);
+
+    return hole_ndx;
+}
+
+int Oware_Playout_Func::choose() const
 {
     auto va = board.valid_actions();
     auto [found, hole_ndx] = hard_choice(va);
 
     if (found)
-    {
-        board.apply_action(hole_ndx);
         return hole_ndx;
-    }
 
     // Otherwise could still use a fancier weight scheme instead of random
 
-    return board.apply_random_action();
+    return board.random_action();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -2,6 +2,7 @@
 #define __OWARE_MCTS_H_
 
 #include "oware.h"
+#include "selection.h"
 
 #include <algorithm>
 #include <cmath>
@@ -19,6 +20,14 @@ namespace oware {
 template<size_t N>
 struct TimeCutoff_UCB_Func
 {
+    // The constant exploration term past the cutoff doesn't change the argmax.
+    double exploration_weight(double expl_cst, unsigned int n_parent_visits) const
+    {
+        return n_parent_visits < N
+            ? expl_cst * mcts::selection::sqrt_log_visits(n_parent_visits)
+            : 0.0;
+    }
+
     auto operator()(double expl_cst, unsigned int n_parent_visits)
     {
         return [expl_cst, n_parent_visits]<typename EdgeT>(const EdgeT& edge)
@@ -43,6 +52,20 @@ public:
         state(_state) { }
 
     action_type operator()() const
+    {
+        action_type action = choose();
+        if (action == -1)
+            return -1;
+
+        bool success = state.apply_action(action);
+
+        return success ? action : -1;
+    }
+
+    /**
+     * The action `operator()()` would play, leaving the board as is.
+    */
+    action_type choose() const
     {
         std::vector<action_type> actions = state.valid_actions();
 
@@ -52,10 +75,7 @@ public:
         std::vector<weight_type> weights(actions.size(), 1);
         set_weights(state, actions, weights);
 
-        action_type action = choose_action(actions, weights);
-        bool success = state.apply_action(action);
-
-        return success ? action : -1;
+        return choose_action(actions, weights);
     }
 
     /**
@@ -179,6 +199,11 @@ public:
 
     int operator()();
 
+    /**
+     * The action `operator()()` would play, leaving the board as is.
+    */
+    int choose() const;
+
     /**
      * As a simplified approach, this function either returns {false, *} if
      * it did not find a viable candidate, or it picks out a specific action
@@ -135,6 +135,102 @@ std::ostream& operator<<(std::ostream& _out, const configure_mcts<MctsAgent>& co
                 << std::endl;
 }
 
+/**
+ * A board hiding its undo_action() overload of apply_action(), so that the
+ * search returns to the root by copying the root state.
+ */
+struct Board_copy_only : Board {
+    Board_copy_only() = default;
+
+    bool apply_action(int action)
+    {
+        return Board::apply_action(action);
+    }
+};
+
+/**
+ * Time the same search when returning to the root by undoing the actions
+ * and by copying the root state.
+ */
+void benchmark_return_to_root(int n_iterations, int n_searches)
+{
+    auto time_searches = [=]<typename State>(State state) {
+        mcts::Mcts<State, int, TimeCutoff_UCB_Func<30>, oware::Oware_Playout_Func, 128> agent(state);
+        agent.set_max_iterations(n_iterations);
+        agent.set_max_time(0);
+
+        utils::Stopwatch sw;
+        for (int i = 0; i < n_searches; ++i) {
+            int action = agent.best_action();
+            agent.apply_root_action(action);
+            state.apply_action(action);
+            if (state.is_terminal())
+                break;
+        }
+        return sw();
+    };
+
+    auto undo_time = time_searches(Board {});
+    auto copy_time = time_searches(Board_copy_only {});
+
+    std::cout << "Return to root with " << n_iterations << " iterations per search:"
+              << "\n  undo: " << undo_time << "ms"
+              << "\n  copy: " << copy_time << "ms"
+              << std::endl;
+}
+
+/**
+ * A board storing its rewards as floats and its actions in a byte in the tree.
+ */
+struct Board_compact : Board {
+    using tree_value_type = float;
+    using action_code_type = int8_t;
+};
+
+/**
+ * A compact board whose nodes also hold their children, a player never having
+ * more than one action per house.
+ */
+struct Board_inline : Board_compact {
+    static constexpr size_t max_branching = 6;
+};
+
+/**
+ * Report the size of the nodes and edges of each layout and the memory taken by
+ * the tree, and time the same search with each of them.
+ *
+ * The edges of Oware take 32 bytes with the default layout and 20 with the
+ * compact one.
+ */
+void benchmark_tree_layout(int n_iterations, int n_searches)
+{
+    auto report = [=]<typename State>(State state, const char* name) {
+        using Tree = mcts::MctsTree<State, int, 128>;
+        mcts::Mcts<State, int, TimeCutoff_UCB_Func<30>, oware::Oware_Playout_Func, 128> agent(state);
+        agent.set_max_iterations(n_iterations);
+        agent.set_max_time(0);
+
+        utils::Stopwatch sw;
+        for (int i = 0; i < n_searches; ++i) {
+            int action = agent.best_action();
+            agent.apply_root_action(action);
+            state.apply_action(action);
+            if (state.is_terminal())
+                break;
+        }
+        std::cout << "  " << name << ": sizeof(Node) = " << sizeof(typename Tree::Node)
+                  << ", sizeof(Edge) = " << sizeof(typename Tree::Edge)
+                  << ", " << agent.get_tree_bytes() / 1024 << "KiB"
+                  << ", " << sw() << "ms"
+                  << std::endl;
+    };
+
+    std::cout << "Tree layouts with " << n_iterations << " iterations per search:" << std::endl;
+    report(Board {}, "default");
+    report(Board_compact {}, "compact");
+    report(Board_inline {}, "compact, inline children");
+}
+
 struct Basic_params
 {
     int time;
@@ -147,6 +243,9 @@ int main()
 {
     using action_type = Board::action_type;
     using reward_type = Board::reward_type;
+
+    benchmark_return_to_root(20000, 20);
+    benchmark_tree_layout(20000, 20);
     // using MctsAgent = mcts::Mcts<Board,
     //     action_type,
     //     TimeCutoff_UCB_Func<30>,
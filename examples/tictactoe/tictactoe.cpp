@@ -23,7 +23,7 @@ namespace ttt {
 ////////////////////////////////////////////////////////////////////////////////
 // For Outputting random actions
 ////////////////////////////////////////////////////////////////////////////////
-Rand::Util<uint8_t> rand_util{ };
+thread_local Rand::Util<uint8_t> rand_util{ };
 
 //} // namespace
 
@@ -27,6 +27,8 @@ public:
     using player_type = Player;
     using reward_type = double;
     using actions_list = std::vector<Square>;
+    /** Nothing more than the move is needed to undo it. */
+    struct undo_type { };
     static void init();
 
     State();
@@ -36,7 +38,10 @@ public:
     bool is_valid(Move move) const;
     actions_list const& valid_actions() const;
     bool apply_action(Move);
+    bool apply_action(Move, undo_type&);
+    void undo_action(Move, const undo_type&);
     action_type apply_random_action();
+    action_type random_action() const;
     Player winner() const;
     bool is_draw() const;
     Player constexpr side_to_move() const;
@@ -255,6 +260,17 @@ inline bool State::apply_action(Move m)
     return res;
 }
 
+inline bool State::apply_action(Move m, undo_type&)
+{
+    return apply_action(m);
+}
+
+inline void State::undo_action(Move m, const undo_type&)
+{
+    m_side_to_move = ~m_side_to_move;
+    m_bb ^= move_bb(m_side_to_move, m);
+}
+
 inline bool State_normal::apply_action(Move m)
 {
     bool ret = false;
@@ -266,17 +282,22 @@ inline bool State_normal::apply_action(Move m)
     return ret;
 }
 
-extern Rand::Util<uint8_t> rand_util;
+extern thread_local Rand::Util<uint8_t> rand_util;
 
 inline State::action_type State::apply_random_action()
 {
     //auto actions = valid_actions();
-    auto action = rand_util.choose(valid_actions());
+    auto action = random_action();
     apply_action(action);
 
     return action;
 }
 
+inline State::action_type State::random_action() const
+{
+    return rand_util.choose(valid_actions());
+}
+
 inline State_normal::action_type State_normal::apply_random_action()
 {
     auto action = rand_util.choose(valid_actions());
@@ -7,6 +7,21 @@
 // - apply_random_action()
 // - apply_action(const ActionT& action)
 // - key()
+//
+// and can optionally implement:
+//
+// - apply_and_evaluate(const ActionT& action), returning `evaluate(action)` and
+//   applying the action in one go.
+// - random_action() const, choosing a random action without applying it, which
+//   lets the default playouts run without copying the state on every ply.
+// - a `undo_type`, with apply_action(const ActionT&, undo_type&) recording what is
+//   needed to take the action back with undo_action(const ActionT&, const undo_type&).
+//   The search then undoes its actions to return to the root instead of copying it.
+// - a `tree_value_type` and an `action_code_type`, shrinking the nodes and edges
+//   of the tree (see `Tree_value` and `Edge_action` in mcts_tree.h).
+// - a static `max_branching` bounding the number of valid actions, so that the
+//   children of the nodes are stored inline (see `max_branching` in mcts_tree.h),
+//   best declared along with the compact layout above.
 
 #ifndef __MCTS_H_
 #define __MCTS_H_
@@ -14,19 +29,94 @@
 #include "mcts_tree.h"
 #include "policies.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <concepts>
+#include <chrono>
+#include <cmath>
 #include <iostream>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stop_token>
+#include <thread>
+#include <utility>
+#include <vector>
 
+#include "utils/deadline.h"
 #include "utils/stopwatch.h"
+#include "utils/thread_pool.h"
 
 
 namespace mcts {
 
+// Strategy options
+enum class BackpropagationStrategy {
+    avg_value,
+    avg_best_value,
+    best_value
+};
+enum class ActionSelection {
+    by_ucb,
+    by_n_visits,
+    by_avg_value,
+    by_best_value
+};
+enum class NPlayers { One, Two };
+
+/**
+ * Fix the number of players and the backpropagation strategy at compile time.
+ *
+ * With one player, no reward is ever flipped, and the backpropagation code of the
+ * strategies not chosen is not compiled at all.
+ */
+template <NPlayers N_PLAYERS,
+    BackpropagationStrategy BACKPROPAGATION = BackpropagationStrategy::avg_best_value>
+struct Static_strategy {
+    static constexpr bool is_static = true;
+    static constexpr NPlayers n_players = N_PLAYERS;
+    static constexpr BackpropagationStrategy backpropagation = BACKPROPAGATION;
+};
+
+/**
+ * Read the number of players and the backpropagation strategy from the
+ * agent's setters, at the cost of a branch per iteration.
+ */
+struct Dynamic_strategy {
+    static constexpr bool is_static = false;
+};
+
+template <typename StateT, typename ActionT>
+concept Has_undo_action = requires(StateT& state, const ActionT& action, typename StateT::undo_type& undo) {
+    { state.apply_action(action, undo) } -> std::convertible_to<bool>;
+    state.undo_action(action, undo);
+};
+
+/**
+ * The record kept for every action applied during a traversal, empty if the
+ * state can't undo its actions.
+ */
+template <typename StateT, typename ActionT>
+struct Undo_record {
+    ActionT action;
+};
+template <typename StateT, typename ActionT>
+    requires Has_undo_action<StateT, ActionT>
+struct Undo_record<StateT, ActionT> {
+    ActionT action;
+    typename StateT::undo_type undo;
+};
+
 template <
     typename StateT,
     typename ActionT,
     typename UCB_Functor = policies::Default_UCB_Func,
     typename Playout_Functor = typename policies::Default_Playout_Func<StateT, ActionT>,
-    size_t MAX_DEPTH = 128
+    size_t MAX_DEPTH = 128,
+    typename Strategy = Dynamic_strategy
     >
 class Mcts;
 
@@ -37,13 +127,106 @@ namespace display {
     class Mcts_view;
 } // namespace display
 
+/**
+ * How the work is split when searching with more than one thread.
+ *
+ * - Root: Every thread searches its own tree and the root statistics are merged at the end.
+ * - Tree: All threads search the same tree, spread out by virtual losses.
+ * - Leaf: One tree, but the playouts of an expansion are run by all threads.
+ */
+enum class Parallelization {
+    Root,
+    Tree,
+    Leaf
+};
+
 // Config Parameters
 struct Config {
     double exploration_constant = 0.7;
     int max_iterations = 1000;
+    /** The time budget in milliseconds (0 for no limit). */
     int max_time = 10000;
-    /** The number of simulations to run when initializing an edge. */
-    int n_rollouts = 5;
+    /** The time budget in microseconds, which takes precedence over `max_time` when positive. */
+    int max_time_us = 0;
+    /**
+     * When larger than the time budget, the search goes on up to this budget (in
+     * milliseconds) while the most visited root move is unstable.
+     */
+    int max_time_stretch = 0;
+    /**
+     * Stop the search as soon as the most visited root move can't be overtaken within
+     * the budget, and right away when it is the only move.
+     */
+    bool stop_when_decided = false;
+    /**
+     * Prove the values of the edges leading to terminal states, and up the tree
+     * whenever a node has a winning child or all its children are proven (MCTS-Solver).
+     * Proven edges are no longer selected, and the search stops once the root is proven.
+     *
+     * @Note The rewards must be in [0, 1], 1 being a win, and the terminal evaluations
+     * exact. The solver is off during a tree parallel search.
+     */
+    bool solver = false;
+    /**
+     * Score the edges with the statistics of the nodes they lead to, which are shared by
+     * all the paths reaching the same state, instead of their own (UCT2 of Childs et al.).
+     * What was learnt about a transposition through one of its parents is then used when
+     * selecting from all of them, the exploration term still counting the edge's visits.
+     */
+    bool dag_values = false;
+    /**
+     * Blend the average value of the edges with their all-moves-as-first value (RAVE),
+     * learnt from every playout where the edge's player played its action later on.
+     * The weight of the AMAF value is sqrt(k / (3 n + k)) for an edge visited n times,
+     * with k the `rave_equivalence`, so it fades out as the edge gets visited.
+     *
+     * @Note The actions and players must be totally ordered, and the state must declare
+     * `amaf_statistics` for its edges to hold them (see `Edge_amaf`), otherwise this is
+     * ignored.
+     */
+    bool rave = false;
+    double rave_equivalence = 100.0;
+    /**
+     * When positive, expand the nodes lazily (progressive widening): a node visited
+     * n times has only its ceil(c (n + 1)^a) best actions open to the search, with c
+     * the `widening_constant` and a the `widening_exponent`, ranked by `StateT::evaluate()`.
+     * A node reached again while it may open more children opens a single one, whose
+     * playouts are the only ones of the iteration, and the others on the next visits.
+     *
+     * @Note Progressive widening is off during a tree parallel search.
+     */
+    double widening_constant = 0.0;
+    double widening_exponent = 0.5;
+    /**
+     * The number of visits of an edge before the node it leads to is inserted in the tree.
+     * Until then, an iteration selecting the edge runs its playouts from the edge's parent,
+     * and only the edge's own statistics learn from them: the many nodes visited only once
+     * or twice are never hashed, nor are the edges of their children allocated.
+     *
+     * @Note Nodes are always inserted during a tree parallel search.
+     */
+    int materialization_threshold = 0;
+    /** The number of simulations run when initializing an edge, whose mean is the edge's value. */
+    int n_rollouts = 1;
+    /**
+     * When positive, the simulations of an edge stop as soon as the standard error of
+     * their mean is below this value (after at least two of them).
+     */
+    double rollout_tolerance = 0.0;
+    /**
+     * The most nodes the tree may hold (0 for no limit). When the limit is reached,
+     * the least visited nodes are evicted down to half of it.
+     */
+    size_t max_nodes = 0;
+    /**
+     * When positive, compact the tree during a search whenever it grew by this fraction
+     * since it was last laid out in depth-first order (see `MctsTree::compact()`), which
+     * rerooting and evicting do too.
+     */
+    double compaction_growth = 0.0;
+    /** The number of threads searching in parallel. */
+    int n_threads = 1;
+    Parallelization parallelization = Parallelization::Root;
 };
 
 template <
@@ -51,19 +234,20 @@ template <
     typename ActionT,
     typename UCB_Functor,
     typename Playout_Functor,
-    size_t MAX_DEPTH>
+    size_t MAX_DEPTH,
+    typename Strategy>
 class Mcts
 {
     friend class display::Mcts_view<StateT, ActionT, MAX_DEPTH>;
 public:
-    // Some typedefs for hygiene and forward declaration of the enums involved in
-    // the configuration and choice of strategy.
-    enum class ActionSelection;
-    enum class BackpropagationStrategy;
+    // Some typedefs for hygiene, and the enums involved in the configuration
+    // and choice of strategy.
+    using ActionSelection = mcts::ActionSelection;
+    using BackpropagationStrategy = mcts::BackpropagationStrategy;
+    using NPlayers = mcts::NPlayers;
     using reward_type = typename StateT::reward_type;
     using player_type = typename StateT::player_type;
     using ActionSequence = typename std::vector<ActionT>;
-    enum class NPlayers { One, Two };
    /**
    * Constructor storing a reference to a state.
   */
@@ -83,9 +267,58 @@ public:
         best_action(ActionSelection = ActionSelection::by_n_visits);
 
     /**
-   * Run the algorithm until the `computation_resources()` returns false.
+     * Same as `best_action_sequence()` and `best_action()`, but the search runs on a
+     * background thread and the result is delivered through the returned future.
+     *
+     * @Note While the search runs, only `cancel_search()`, `extend_search()` and
+     * `search_progress()` may be called. Any other call stops the search first, which
+     * then delivers the best result found so far.
+    */
+    std::future<ActionSequence>
+        best_action_sequence_async(ActionSelection = ActionSelection::by_best_value);
+    std::future<ActionT>
+        best_action_async(ActionSelection = ActionSelection::by_n_visits);
+
+    /**
+     * Ask the background search to stop as soon as possible. The future then
+     * holds the best result found so far.
+    */
+    void cancel_search();
+
+    /**
+     * Add iterations or milliseconds to the budget of the running search, which can be
+     * called from any thread.
+     *
+     * @Note The extensions are dropped when the next search starts.
+    */
+    void extend_search(int n_iterations, int time = 0);
+
+    /**
+     * A snapshot of the root statistics of the running search.
+    */
+    struct Search_progress {
+        int n_iterations = 0;
+        /** The average value and the number of visits of each root edge, as in `root_moves_eval()`. */
+        std::vector<std::pair<double, int>> root_moves;
+        /** The most visited root action, if the root was expanded. */
+        std::optional<ActionT> best_action;
+        bool done = false;
+    };
+
+    /**
+     * Return the last snapshot published by the background search, which can be
+     * called from any thread.
+     *
+     * @Note The snapshot is refreshed every `progress_period` iterations. With
+     * root parallelization, it only reflects our own tree until the end of the search.
+    */
+    Search_progress search_progress() const;
+
+    /**
+   * Run the algorithm until the `computation_resources()` returns false, or
+   * until a stop is requested on the given token.
   */
-    void run();
+    void run(std::stop_token = {});
 
     /**
      * Sends a representation of the current tree in a json format
@@ -93,11 +326,40 @@ public:
     void display_tree(std::ostream&, int depth=0);
 
     /**
-     * Apply a move to the root state, pruning all other root edges
+     * Apply a move to the root state, keeping the subtree under the move and
+     * releasing the rest of the tree.
      * @Note The action is pushed at the back of `m_actions_done`.
     */
     void apply_root_action(const ActionT&);
 
+    /**
+     * Release the whole tree at once and start over from the given state,
+     * keeping the configuration and the memory already allocated.
+    */
+    void reset(const StateT&);
+
+    /**
+     * Keep searching from the current root on a background thread, typically
+     * while the opponent thinks, until `stop_ponder()` is called.
+     *
+     * @Note `apply_root_action()`, `run()`, `best_action()` and `reset()` stop the
+     * pondering first, so the subtree of the move actually played keeps the visits
+     * invested in it. The agent must not be used otherwise while pondering.
+     * @Note Pondering runs on a single thread, and grows the tree until stopped unless
+     * `max_nodes` is set.
+    */
+    void start_ponder();
+
+    /**
+     * Stop the background search started by `start_ponder()`, if any.
+    */
+    void stop_ponder();
+
+    bool pondering() const
+    {
+        return m_pondering;
+    }
+
     /**
      * Return the time elapsed in milliseconds since the construction
      * of the agent or the last call to `init_counters()`.
@@ -109,10 +371,10 @@ public:
 
     std::vector<std::pair<double, int>> root_moves_eval() const
     {
-        node_pointer p_root = m_tree.get_root();
+        const auto children = m_tree.children(m_tree.get_root());
         std::vector<std::pair<double, int>> ret;
-        std::transform(p_current_node->children.begin(),
-                       p_current_node->children.end(),
+        std::transform(children.begin(),
+                       children.end(),
                        std::back_inserter(ret),
                        [](const auto& e) {
                            return std::make_pair(e.total_val / (e.n_visits + 1.0), e.n_visits);
@@ -142,30 +404,207 @@ private:
 
     StateT m_state;
     //StateT& m_state;
-    Tree m_tree;
+    std::unique_ptr<Tree> p_own_tree;
+    Tree& m_tree;
+    typename Tree::Traversal m_traversal;
     node_pointer p_current_node;
     StateT m_root_state;
     UCB_Functor UCB_Func;
 
     Config m_config;
-    BackpropagationStrategy backpropagation_strategy = BackpropagationStrategy::avg_value;
+    BackpropagationStrategy backpropagation_strategy = BackpropagationStrategy::avg_best_value;
     ActionSequence m_actions_done;
     NPlayers n_players = NPlayers::Two;
     int iteration_cnt;
     ::utils::Stopwatch m_stopwatch;
+    ::utils::Deadline m_deadline;
+
+    // Root parallelization: the workers running the helper agents, the
+    // iteration counter shared by all agents of a parallel search and the
+    // number of nodes the helpers created during the last search.
+    std::unique_ptr<::utils::ThreadPool> m_pool;
+    std::atomic<int>* p_shared_iterations = nullptr;
+    size_t m_helper_nodes = 0;
+
+    // The number of nodes evicted to stay within `m_config.max_nodes`.
+    size_t m_n_evicted = 0;
+
+    static constexpr bool has_amaf = Tree::has_amaf && std::totally_ordered<ActionT> && std::totally_ordered<player_type>;
+    using Amaf_key = std::pair<player_type, ActionT>;
+
+    /**
+     * The playouts of an iteration where a player played an action: the sum of their
+     * values from the player's point of view, their number, and the index of the last one.
+     */
+    struct Amaf_stat {
+        reward_type val = 0.0;
+        int count = 0;
+        int last_playout = -1;
+    };
+
+    /**
+     * Scratch states for the playouts, reused from one playout to the next.
+     * (One set per thread in a leaf parallel search, the first one being ours.)
+     */
+    struct Playout_buffers {
+        StateT backup;
+        StateT sim;
+        StateT sim_prev;
+        /** With RAVE, the statistics of the actions of `m_amaf_keys` in the playouts of the iteration. */
+        std::vector<Amaf_stat> amaf = {};
+        /** The indices of the actions played in the current playout. */
+        std::vector<size_t> amaf_played = {};
+        /** The number of playouts of the iteration, and the sum of their values. */
+        int amaf_n_playouts = 0;
+        reward_type amaf_total_val = 0.0;
+    };
+    std::vector<Playout_buffers> m_playout_buffers;
+    /** The scores of the valid actions of the node expanded, with their indices. */
+    std::vector<std::pair<reward_type, size_t>> m_action_scores;
+    /**
+     * The value of the iteration when it comes from the playouts of a single edge: a child
+     * opened by progressive widening, or an edge whose node is not materialized yet.
+     */
+    std::optional<reward_type> m_playout_value;
+    /** The edge selected by the iteration whose node is not materialized yet, if any. */
+    edge_pointer p_deferred_edge = nullptr;
+
+    /**
+     * The actions whose AMAF statistics are updated by the current iteration, sorted:
+     * those of the edges leaving the nodes of the traversal and of the expanded node.
+     */
+    std::vector<Amaf_key> m_amaf_keys;
+
+    static constexpr bool has_undo = Has_undo_action<StateT, ActionT>;
+
+    /**
+     * The actions applied to `m_state` since the root, when the state can undo them.
+     *
+     * @Note `m_state_on_path` is false when `m_state` was changed some other way,
+     * and then returning to the root copies the root state.
+     */
+    std::array<Undo_record<StateT, ActionT>, has_undo ? MAX_DEPTH : 0> m_undo_stack;
+    size_t m_undo_depth = 0;
+    bool m_state_on_path = true;
+public:
+    /**
+     * The nodes kept and released by `apply_root_action()` and the time it
+     * took, summed over all the moves since the construction or the last `reset()`.
+    */
+    struct Reuse_stats {
+        size_t n_kept = 0;
+        size_t n_freed = 0;
+        size_t n_moves = 0;
+        std::chrono::microseconds time { 0 };
+    };
+private:
+    Reuse_stats m_reuse_stats;
+
+    // Cancellation of the current search, and the iterations and time added to its
+    // budget by `extend_search()` (shared with the helper agents of a parallel search).
+    std::stop_token m_stop_token;
+    struct Budget_extension {
+        std::atomic<int> n_iterations = 0;
+        std::atomic<int> time = 0;
+    };
+    Budget_extension m_extension;
+    Budget_extension* p_extension = &m_extension;
+
+    // The snapshots of `search_progress()`, published by the background search.
+    static constexpr int progress_period = 256;
+    bool m_publish_progress = false;
+    mutable std::mutex m_progress_mutex;
+    Search_progress m_progress;
+
+    // What `check_root()` found on its last call: the most visited root move and
+    // whether it is unstable or decided.
+    static constexpr int root_check_period = 64;
+    std::optional<ActionT> m_root_best;
+    bool m_root_unstable = false;
+    bool m_root_decided = false;
+
+    // Set by the solver when the value of the root is proven.
+    bool m_root_solved = false;
+
+    // The iterations run by the last `start_ponder()`, and the thread running the
+    // pondering or the asynchronous search (declared last so that it is joined
+    // before the members it uses are destroyed).
+    size_t m_ponder_iterations = 0;
+    bool m_pondering = false;
+    std::jthread m_background;
 public:
     using node_type = typename Tree::Node;
 private:
+    /**
+     * Constructor for the helper agents of a tree parallel search, which
+     * search the tree of another agent.
+    */
+    Mcts(const StateT& root_state,
+         Tree& shared_tree,
+         UCB_Functor);
+
     /**
    * Complete a full cycle of the algorithm.
   */
     void step();
 
+    /**
+     * Run `step()` until `computation_resources()` returns false.
+    */
+    void search();
+
+    /**
+     * The body of `run()`, which may run on the background thread.
+    */
+    void run_search(std::stop_token);
+
+    /**
+     * Run the search on the background thread, then deliver `choose()` through the future.
+    */
+    template <typename F>
+    auto run_async(F choose) -> std::future<decltype(choose())>;
+
+    /**
+     * Stop the pondering or the asynchronous search, if any, and return to the root.
+    */
+    void stop_background();
+
+    /**
+     * Publish the root statistics for `search_progress()`.
+    */
+    void publish_progress(bool done);
+
+    /**
+     * Search `n_threads - 1` independent trees on the thread pool alongside our own,
+     * each helper with its own copy of the root state, then merge the statistics of
+     * the helpers' root edges into ours.
+     *
+     * @Note The iteration and time budgets are shared by all trees.
+    */
+    void run_root_parallel();
+
+    /**
+     * Search our tree with `n_threads - 1` helper agents on the thread pool, each
+     * with its own copy of the root state and its own traversal.
+     *
+     * @Note The iteration and time budgets are shared by all agents.
+    */
+    void run_tree_parallel();
+
+    /**
+     * Search our tree alone, but with the playouts of every expansion spread over
+     * the thread pool.
+    */
+    void run_leaf_parallel();
+
     /**
    * Select the best edge from the current node according to the given method.
   */
     edge_pointer get_best_edge(ActionSelection);
 
+    template <ActionSelection METHOD>
+    edge_pointer get_best_edge();
+
     /**
    * The *Selection* phase of the algorithm.
    */
@@ -185,6 +624,60 @@ private:
   */
     reward_type simulate_playout(const ActionT&, int = 1);
 
+    /**
+     * Same as above, using the given scratch states.
+     *
+     * @Note All the simulations reuse the same scratch states, and stop early once
+     * the standard error of their mean is below `m_config.rollout_tolerance`.
+    */
+    reward_type simulate_playout(const ActionT&, int, Playout_buffers&) const;
+
+    /**
+     * Run a single simulation of `simulate_playout()`.
+    */
+    reward_type run_playout(const ActionT&, Playout_buffers&) const;
+
+    /**
+     * Whether the playouts record their actions for RAVE.
+    */
+    bool recording_amaf() const
+    {
+        return has_amaf && m_config.rave;
+    }
+
+    /**
+     * Collect the actions whose AMAF statistics the playouts of the expansion of the
+     * current node (whose open edges are given) update, and reset the statistics of
+     * the playout buffers.
+    */
+    void prepare_amaf(std::span<const edge_type>);
+
+    /**
+     * Record that the player played the action in the current playout.
+    */
+    void note_amaf(Playout_buffers&, player_type, const ActionT&) const;
+
+    /**
+     * Give the value of the current playout to the actions it played.
+    */
+    void close_amaf_playout(Playout_buffers&, reward_type) const;
+
+    /**
+     * Add the playouts of the expansion of the current node to the AMAF statistics
+     * of the edges leaving the nodes of the traversal, the current node included,
+     * whose action was played by their player below the node.
+     *
+     * @Note The actions of the traversal below a node count as played in all the playouts.
+    */
+    void update_amaf();
+
+    /**
+     * Evaluate the action from the given state, then apply it.
+     *
+     * @Note States can merge both steps by providing `apply_and_evaluate(const ActionT&)`.
+    */
+    static reward_type apply_and_evaluate(StateT&, const ActionT&);
+
     /**
      * For when the current node is a leaf, run `simulate_playout` on all the state's
      * valid actions and populate the current node with children edges corresponding
@@ -195,6 +688,12 @@ private:
    */
     void expand_current_node();
 
+    /**
+     * Run the playouts of the edge selected by the iteration whose node is not materialized,
+     * from the current node, and add the edge to the traversal (see `defers_node()`).
+    */
+    void simulate_deferred_edge();
+
     /**
      * After expanding the leaf node, update the statistics of all edges connecting it
      * to the root with the results obtained from the simulated playouts, according to
@@ -202,17 +701,163 @@ private:
    */
     void backpropagate();
 
+    /**
+     * The value of the freshly expanded current node which is backpropagated
+     * with the given strategy.
+    */
+    template <BackpropagationStrategy STRATEGY>
+    reward_type children_value() const;
+
+    /**
+     * Mark the edge leading to the current node as proven if the current node is terminal,
+     * and then its ancestors as long as their values are proven too.
+     *
+     * @Note Must be called at the end of the traversal, before backpropagating.
+    */
+    void solve();
+
+    /**
+     * The value of the node proven by its children, if any, from the point of
+     * view of the given player.
+    */
+    std::optional<reward_type> proven_value(const node_type*, player_type) const;
+
+    /**
+     * Among the proven root edges, return a win, or the best edge according to the
+     * method which is not a proven loss. Return nullptr if there is no proven root edge.
+    */
+    edge_pointer get_proven_edge(ActionSelection);
+
+    /**
+     * The mean value used to select the edge: its average value, or with `dag_values`
+     * the average value of the node it leads to once rewards went through it.
+     *
+     * @Note The value of a proven edge is always its own.
+    */
+    reward_type edge_value(const edge_type& e) const
+    {
+        using selection::load;
+        if (m_config.dag_values && !load(e.subtree_completed)) {
+            const node_type* child = m_tree.child(&e);
+            const int n_backups = child ? load(child->n_backups) : 0;
+            if (n_backups > 0) {
+                const reward_type value = load(child->total_val) / n_backups;
+                return two_players() && child->player != e.player ? 1.0 - value : value;
+            }
+        }
+        return load(e.total_val) * selection::inv_visits(load(e.n_visits));
+    }
+
+    /**
+     * The mean value maximized with the exploration term during the selection:
+     * `edge_value()` blended with the AMAF value of the edge when RAVE is on.
+    */
+    reward_type selection_value(const edge_type& e) const
+    {
+        using selection::load;
+        const reward_type value = edge_value(e);
+        if constexpr (has_amaf) {
+            const int amaf_visits = m_config.rave ? load(e.amaf.visits) : 0;
+            if (amaf_visits == 0 || load(e.subtree_completed))
+                return value;
+
+            const double k = m_config.rave_equivalence;
+            const double beta = std::sqrt(k / (3.0 * (load(e.n_visits) + 1) + k));
+            return (1.0 - beta) * value + beta * load(e.amaf.val) / amaf_visits;
+        }
+        return value;
+    }
+
+    /**
+     * A copy of the edge whose statistics are read with `selection::load()`, for the
+     * UCB functors reading an edge as a whole while other searchers update it.
+    */
+    edge_type edge_snapshot(const edge_type& e) const
+    {
+        using selection::load;
+        edge_type ret;
+        ret.action = e.action;
+        ret.player = e.player;
+        ret.subtree_completed = load(e.subtree_completed);
+        ret.n_visits = load(e.n_visits);
+        ret.total_val = load(e.total_val);
+        ret.best_val = load(e.best_val);
+        ret.child = load(e.child);
+        if constexpr (Tree::has_amaf) {
+            ret.amaf.val = load(e.amaf.val);
+            ret.amaf.visits = load(e.amaf.visits);
+        }
+        return ret;
+    }
+
+    bool widening() const
+    {
+        return m_config.widening_constant > 0.0 && !m_tree.concurrent();
+    }
+
+    /**
+     * The number of children the progressive widening opens at a node visited once more.
+    */
+    size_t n_open_children(const node_type* node) const
+    {
+        const double target = std::ceil(m_config.widening_constant
+            * std::pow(node->n_visits + 1.0, m_config.widening_exponent));
+        return std::clamp<size_t>(size_t(target), node->n_children, node->n_actions);
+    }
+
+    /**
+     * True if the progressive widening opens a child of the node when it is visited again.
+    */
+    bool can_widen(const node_type* node) const
+    {
+        return widening() && node->n_children < node->n_actions && node->n_children < n_open_children(node);
+    }
+
+    /**
+     * True if the node the edge leads to is not inserted yet when the edge is selected
+     * (see `Config::materialization_threshold`).
+    */
+    bool defers_node(const edge_type* edge) const
+    {
+        return edge->n_visits < m_config.materialization_threshold
+            && !m_tree.child(edge)
+            && !edge->subtree_completed
+            && !m_tree.concurrent();
+    }
+
+    bool two_players() const
+    {
+        if constexpr (Strategy::is_static)
+            return Strategy::n_players == NPlayers::Two;
+        else
+            return n_players == NPlayers::Two;
+    }
+
     /**
      * Resets `m_current_node` with a reference to the root node, and reset the
      * state with the data from `m_root_state`.
+     *
+     * @Note When the state can undo actions, the actions applied since the root
+     * are undone instead of copying `m_root_state`.
    */
     void return_to_root();
 
+    /**
+     * Undo the actions applied to `m_state` since the root, or copy the root
+     * state if that is not possible.
+   */
+    void restore_root_state();
+
 
     /**
      * Apply the edge's action to the state and update `m_current_node`.
+     *
+     * @Note An edge traversed before leads straight to its node through its `child`
+     * link, so only the first traversal hashes the new state into the tree.
+     * @Note Return false, leaving the state as it is, if the action can't be applied:
+     * the node was reached with a state of another position whose key is the same.
    */
-    void traverse_edge(edge_pointer);
+    bool traverse_edge(edge_pointer);
 
     /**
    * Using the given selection method, return the best path from root to leaf according to
@@ -240,33 +885,69 @@ private:
 
     /**
     * Return true if the agent can continue with the algorithm.
+    *
+    * @Note The clock is only read every few iterations, see `utils::Deadline`.
    */
     bool computation_resources();
 
+    /**
+     * The time budget of the current search, extensions and stretch included, or 0
+     * for no limit.
+    */
+    ::utils::Deadline::Duration time_budget() const;
+
+    /**
+     * Compare the root edges to decide whether to stretch the time budget or stop
+     * early, according to `max_time_stretch` and `stop_when_decided`.
+     *
+     * @Note The most visited move is unstable when it changed since the last check, or
+     * when it doesn't have the best average value. It is decided when the second most
+     * visited move can't catch up with it in the iterations the budget has left.
+    */
+    void check_root();
+
     /**
     * Initialize the counters and time to 0.
    */
     void init_counters();
 
-public:
-    // Strategy options
-    enum class BackpropagationStrategy {
-        avg_value,
-        avg_best_value,
-        best_value
-    };
-    enum class ActionSelection {
-        by_ucb,
-        by_n_visits,
-        by_avg_value,
-        by_best_value
-    };
+    /**
+     * Return true if the tree holds as many nodes as `m_config.max_nodes` allows.
+    */
+    bool tree_full() const;
+
+    /**
+     * Evict the least visited nodes of the tree down to half of `m_config.max_nodes`
+     * and return to the root.
+     *
+     * @Note Return the number of nodes evicted.
+    */
+    size_t evict_nodes();
 
+    /**
+     * Return true if the tree grew enough since it was last compacted (see
+     * `m_config.compaction_growth`).
+    */
+    bool needs_compaction() const;
+
+    /**
+     * Compact the tree and return to the root.
+    */
+    void compact_tree();
+
+    /** Smaller trees are not worth compacting during a search. */
+    static constexpr size_t min_compaction_size = 4096;
+
+public:
     // Configuration options
     void set_exploration_constant(double c)
     {
         m_config.exploration_constant = c;
     }
+    /**
+     * @Note The backpropagation strategy and the number of players are ignored
+     * when they are fixed by a `Static_strategy`.
+    */
     void set_backpropagation_strategy(BackpropagationStrategy strat)
     {
         backpropagation_strategy = strat;
@@ -279,6 +960,44 @@ public:
     void set_max_time(int t)
     {
         m_config.max_time = t;
+        m_config.max_time_us = 0;
+    }
+    void set_max_time_us(int t)
+    {
+        m_config.max_time_us = t;
+    }
+    void set_max_time_stretch(int t)
+    {
+        m_config.max_time_stretch = t;
+    }
+    void set_stop_when_decided(bool b)
+    {
+        m_config.stop_when_decided = b;
+    }
+    void set_solver(bool b)
+    {
+        m_config.solver = b;
+    }
+    void set_dag_values(bool b)
+    {
+        m_config.dag_values = b;
+    }
+    void set_rave(bool b)
+    {
+        m_config.rave = b;
+    }
+    void set_rave_equivalence(double k)
+    {
+        m_config.rave_equivalence = k;
+    }
+    void set_widening(double c, double a = 0.5)
+    {
+        m_config.widening_constant = c;
+        m_config.widening_exponent = a;
+    }
+    void set_materialization_threshold(int n)
+    {
+        m_config.materialization_threshold = n;
     }
     void set_n_players(NPlayers np)
     {
@@ -288,13 +1007,75 @@ public:
     {
         m_config.n_rollouts = n;
     }
+    void set_rollout_tolerance(double tol)
+    {
+        m_config.rollout_tolerance = tol;
+    }
+    void set_max_nodes(size_t n)
+    {
+        m_config.max_nodes = n;
+        m_tree.reserve(n);
+    }
+    void set_compaction_growth(double growth)
+    {
+        m_config.compaction_growth = growth;
+    }
+    void set_n_threads(int n)
+    {
+        m_config.n_threads = n;
+    }
+    void set_parallelization(Parallelization p)
+    {
+        m_config.parallelization = p;
+    }
     unsigned int get_iterations_cnt() const
     {
         return iteration_cnt;
     }
     size_t get_n_nodes() const
     {
-        return m_tree.size();
+        return m_tree.size() + m_helper_nodes;
+    }
+    /**
+     * The number of nodes evicted to respect the `max_nodes` limit, since the
+     * construction or the last `reset()`.
+    */
+    size_t get_n_evicted() const
+    {
+        return m_n_evicted;
+    }
+    /**
+     * True if the solver proved the value of the root during the last search.
+    */
+    bool root_solved() const
+    {
+        return m_root_solved;
+    }
+    /**
+     * The memory held by the tree's arenas and table.
+    */
+    size_t get_tree_bytes() const
+    {
+        return m_tree.bytes_reserved();
+    }
+    /**
+     * The number of iterations run in the background by the last `start_ponder()`.
+    */
+    size_t get_ponder_iterations() const
+    {
+        return m_ponder_iterations;
+    }
+    const Reuse_stats& get_reuse_stats() const
+    {
+        return m_reuse_stats;
+    }
+    double get_table_load_factor() const
+    {
+        return m_tree.load_factor();
+    }
+    auto get_table_probe_stats() const
+    {
+        return m_tree.probe_stats();
     }
 };
 
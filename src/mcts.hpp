@@ -4,17 +4,26 @@
 #include "mcts.h"
 #include "mcts_tree.h"
 #include "policies.h"
+#include "selection.h"
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cmath>
 #include <functional>
+#include <future>
 #include <iostream>
 #include <iomanip>
+#include <limits>
+#include <memory>
 #include <numeric>
+#include <span>
 #include <thread>
+#include <utility>
 #include <vector>
 
 #include "utils/stopwatch.h"
+#include "utils/thread_pool.h"
 
 namespace mcts {
 
@@ -22,15 +31,19 @@ template <typename StateT,
     typename ActionT,
     typename UCB_Functor,
     typename Playout_Functor,
-    size_t MAX_DEPTH>
-Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH>::Mcts(
+    size_t MAX_DEPTH,
+    typename Strategy>
+Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::Mcts(
     StateT& state, UCB_Functor ucb_func)
     : m_state(state)
-    , m_tree(state.key())
+    , p_own_tree(std::make_unique<Tree>(state.key()))
+    , m_tree(*p_own_tree)
+    , m_traversal {}
     , p_current_node(m_tree.get_root())
     , m_root_state(state)
     , UCB_Func { ucb_func }
     , m_stopwatch {}
+    , m_playout_buffers(1, Playout_buffers { state, state, state })
 {
     m_tree.reserve(m_config.max_iterations);
 }
@@ -39,8 +52,29 @@ template <typename StateT,
     typename ActionT,
     typename UCB_Functor,
     typename Playout_Functor,
-    size_t MAX_DEPTH>
-inline ActionT Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH>::best_action(
+    size_t MAX_DEPTH,
+    typename Strategy>
+Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::Mcts(
+    const StateT& root_state, Tree& shared_tree, UCB_Functor ucb_func)
+    : m_state(root_state)
+    , p_own_tree()
+    , m_tree(shared_tree)
+    , m_traversal {}
+    , p_current_node(m_tree.get_root())
+    , m_root_state(root_state)
+    , UCB_Func { ucb_func }
+    , m_stopwatch {}
+    , m_playout_buffers(1, Playout_buffers { root_state, root_state, root_state })
+{
+}
+
+template <typename StateT,
+    typename ActionT,
+    typename UCB_Functor,
+    typename Playout_Functor,
+    size_t MAX_DEPTH,
+    typename Strategy>
+inline ActionT Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::best_action(
     ActionSelection method)
 {
     run();
@@ -48,7 +82,7 @@ inline ActionT Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH>::b
     edge_pointer edge = get_best_edge(method);
 
 #ifdef DEBUG_BEST_ACTION
-    const auto& children = p_current_node->children;
+    const auto& children = m_tree.children(p_current_node);
 
     std::cerr << "\n\nAt node\n"
                   << m_state
@@ -81,9 +115,10 @@ template <typename StateT,
     typename ActionT,
     typename UCB_Functor,
     typename Playout_Functor,
-    size_t MAX_DEPTH>
-inline typename Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH>::ActionSequence
-Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH>::best_action_sequence(
+    size_t MAX_DEPTH,
+    typename Strategy>
+inline typename Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::ActionSequence
+Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::best_action_sequence(
     ActionSelection method)
 {
     run();
@@ -94,52 +129,479 @@ template <typename StateT,
     typename ActionT,
     typename UCB_Functor,
     typename Playout_Functor,
-    size_t MAX_DEPTH>
-inline void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH>::run()
+    size_t MAX_DEPTH,
+    typename Strategy>
+inline void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::run(std::stop_token stop)
 {
+    stop_background();
+    m_extension.n_iterations.store(0, std::memory_order_relaxed);
+    m_extension.time.store(0, std::memory_order_relaxed);
+    run_search(stop);
+}
+
+template <typename StateT,
+    typename ActionT,
+    typename UCB_Functor,
+    typename Playout_Functor,
+    size_t MAX_DEPTH,
+    typename Strategy>
+inline void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::run_search(std::stop_token stop)
+{
+    m_stop_token = stop;
     init_counters();
     return_to_root();
-    if (p_current_node->n_visits > 0 && p_current_node->children.size() == 0) {
+    if (p_current_node->n_visits > 0 && m_tree.children(p_current_node).size() == 0) {
         return;
     }
+    if (m_config.n_threads > 1) {
+        switch (m_config.parallelization) {
+        case Parallelization::Root:
+            run_root_parallel();
+            break;
+        case Parallelization::Tree:
+            run_tree_parallel();
+            break;
+        case Parallelization::Leaf:
+            run_leaf_parallel();
+            break;
+        }
+    } else {
+        search();
+    }
+    m_stop_token = {};
+}
+
+template <typename StateT,
+    typename ActionT,
+    typename UCB_Functor,
+    typename Playout_Functor,
+    size_t MAX_DEPTH,
+    typename Strategy>
+inline void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::cancel_search()
+{
+    m_background.request_stop();
+}
+
+template <typename StateT,
+    typename ActionT,
+    typename UCB_Functor,
+    typename Playout_Functor,
+    size_t MAX_DEPTH,
+    typename Strategy>
+inline void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::extend_search(int n_iterations, int time)
+{
+    p_extension->n_iterations.fetch_add(n_iterations, std::memory_order_relaxed);
+    p_extension->time.fetch_add(time, std::memory_order_relaxed);
+}
+
+template <typename StateT,
+    typename ActionT,
+    typename UCB_Functor,
+    typename Playout_Functor,
+    size_t MAX_DEPTH,
+    typename Strategy>
+typename Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::Search_progress
+Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::search_progress() const
+{
+    std::lock_guard<std::mutex> lock(m_progress_mutex);
+    return m_progress;
+}
+
+template <typename StateT,
+    typename ActionT,
+    typename UCB_Functor,
+    typename Playout_Functor,
+    size_t MAX_DEPTH,
+    typename Strategy>
+void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::publish_progress(bool done)
+{
+    Search_progress progress;
+    progress.n_iterations = iteration_cnt;
+    progress.done = done;
+
+    const auto children = m_tree.children(m_tree.get_root());
+    progress.root_moves.reserve(children.size());
+    for (const auto& e : children) {
+        progress.root_moves.emplace_back(e.total_val / (e.n_visits + 1.0), e.n_visits);
+    }
+    if (!children.empty()) {
+        progress.best_action = children[selection::argmax(children, [](const auto& e) { return e.n_visits; })].action;
+    }
+
+    std::lock_guard<std::mutex> lock(m_progress_mutex);
+    m_progress = std::move(progress);
+}
+
+template <typename StateT,
+    typename ActionT,
+    typename UCB_Functor,
+    typename Playout_Functor,
+    size_t MAX_DEPTH,
+    typename Strategy>
+template <typename F>
+auto Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::run_async(F choose) -> std::future<decltype(choose())>
+{
+    stop_background();
+    m_extension.n_iterations.store(0, std::memory_order_relaxed);
+    m_extension.time.store(0, std::memory_order_relaxed);
+
+    std::promise<decltype(choose())> promise;
+    auto ret = promise.get_future();
+    {
+        std::lock_guard<std::mutex> lock(m_progress_mutex);
+        m_progress = Search_progress {};
+    }
+
+    m_background = std::jthread([this, choose, promise = std::move(promise)](std::stop_token stop) mutable {
+        m_publish_progress = true;
+        run_search(stop);
+        m_publish_progress = false;
+        return_to_root();
+        publish_progress(true);
+        promise.set_value(choose());
+    });
+    return ret;
+}
+
+template <typename StateT,
+    typename ActionT,
+    typename UCB_Functor,
+    typename Playout_Functor,
+    size_t MAX_DEPTH,
+    typename Strategy>
+std::future<typename Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::ActionSequence>
+Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::best_action_sequence_async(ActionSelection method)
+{
+    return run_async([this, method] { return best_traversal(method); });
+}
+
+template <typename StateT,
+    typename ActionT,
+    typename UCB_Functor,
+    typename Playout_Functor,
+    size_t MAX_DEPTH,
+    typename Strategy>
+std::future<ActionT>
+Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::best_action_async(ActionSelection method)
+{
+    return run_async([this, method] { return get_best_edge(method)->action; });
+}
+
+template <typename StateT,
+    typename ActionT,
+    typename UCB_Functor,
+    typename Playout_Functor,
+    size_t MAX_DEPTH,
+    typename Strategy>
+inline void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::search()
+{
+    const bool check = m_config.max_time_stretch > 0 || m_config.stop_when_decided;
+
     while (computation_resources()) {
         step();
+        if (check && (iteration_cnt == 1 || iteration_cnt % root_check_period == 0)) {
+            check_root();
+        }
+        if (m_publish_progress && iteration_cnt % progress_period == 0) {
+            publish_progress(false);
+        }
+    }
+}
+
+template <typename StateT,
+    typename ActionT,
+    typename UCB_Functor,
+    typename Playout_Functor,
+    size_t MAX_DEPTH,
+    typename Strategy>
+void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::run_root_parallel()
+{
+    const size_t n_helpers = m_config.n_threads - 1;
+    if (!m_pool || m_pool->size() != n_helpers) {
+        m_pool = std::make_unique<::utils::ThreadPool>(n_helpers);
+    }
+
+    std::atomic<int> shared_iterations { 0 };
+    p_shared_iterations = &shared_iterations;
+
+    // Every tree gets its share of the node budget.
+    const size_t max_nodes = m_config.max_nodes;
+    if (max_nodes > 0) {
+        m_config.max_nodes = std::max<size_t>(1, max_nodes / m_config.n_threads);
+    }
+
+    std::vector<std::unique_ptr<Mcts>> helpers;
+    std::vector<std::future<void>> searches;
+    helpers.reserve(n_helpers);
+    searches.reserve(n_helpers);
+
+    for (size_t i = 0; i < n_helpers; ++i) {
+        auto& helper = helpers.emplace_back(std::make_unique<Mcts>(m_root_state, UCB_Func));
+        helper->m_config = m_config;
+        helper->m_config.n_threads = 1;
+        helper->backpropagation_strategy = backpropagation_strategy;
+        helper->n_players = n_players;
+        helper->p_shared_iterations = &shared_iterations;
+        helper->iteration_cnt = 0;
+        helper->m_stopwatch = m_stopwatch;
+        helper->m_deadline = m_deadline;
+        helper->m_stop_token = m_stop_token;
+        helper->p_extension = p_extension;
+
+        searches.push_back(m_pool->submit([h = helper.get()] {
+            h->search();
+        }));
+    }
+
+    search();
+
+    for (auto& s : searches) {
+        s.get();
+    }
+    p_shared_iterations = nullptr;
+    m_config.max_nodes = max_nodes;
+
+    // Merge the helpers' root statistics into our own root edges.
+    node_pointer p_root = m_tree.get_root();
+
+    for (const auto& helper : helpers) {
+        node_pointer p_helper_root = helper->m_tree.get_root();
+        auto helper_children = helper->m_tree.children(p_helper_root);
+
+        // If our own search never got to expand the root, take the helper's edges as they are.
+        if (p_root->n_actions == 0 && !helper_children.empty()) {
+            const auto helper_actions = helper->m_tree.all_children(p_helper_root);
+            auto new_children = m_tree.allocate_children(p_root, helper_actions.size());
+            std::copy(helper_actions.begin(), helper_actions.end(), new_children.begin());
+            p_root->n_children = p_helper_root->n_children;
+            // The helper's nodes are not ours.
+            for (auto& e : new_children) {
+                e.child = Tree::no_node;
+            }
+            p_root->n_visits += p_helper_root->n_visits;
+            iteration_cnt += helper->iteration_cnt;
+            m_helper_nodes += helper->m_tree.size();
+            m_n_evicted += helper->m_n_evicted;
+            continue;
+        }
+
+        auto actions = m_tree.all_children(p_root);
+        for (const auto& h_edge : helper_children) {
+            auto it = std::find_if(actions.begin(), actions.end(), [&h_edge](const auto& e) {
+                return e.action == h_edge.action;
+            });
+            if (it == actions.end()) {
+                continue;
+            }
+            // An edge we did not open yet (progressive widening) takes the helper's statistics.
+            if (size_t(it - actions.begin()) >= p_root->n_children) {
+                auto& opened = actions[p_root->n_children++];
+                std::swap(*it, opened);
+                opened = h_edge;
+                opened.child = Tree::no_node;
+                continue;
+            }
+            it->total_val += h_edge.total_val;
+            it->n_visits += h_edge.n_visits;
+            if constexpr (Tree::has_amaf) {
+                it->amaf.val += h_edge.amaf.val;
+                it->amaf.visits += h_edge.amaf.visits;
+            }
+            if (h_edge.subtree_completed || it->subtree_completed) {
+                // A proven value overrides the statistics.
+                if (h_edge.subtree_completed) {
+                    it->best_val = h_edge.best_val;
+                }
+                it->subtree_completed = true;
+                it->total_val = it->best_val * (it->n_visits + 1);
+            } else {
+                it->best_val = std::max(it->best_val, h_edge.best_val);
+            }
+        }
+
+        p_root->n_visits += p_helper_root->n_visits;
+        iteration_cnt += helper->iteration_cnt;
+        m_helper_nodes += helper->m_tree.size();
+        m_n_evicted += helper->m_n_evicted;
+    }
+    if (p_root->n_children > 0) {
+        Tree::publish(p_root);
+    }
+
+    return_to_root();
+}
+
+template <typename StateT,
+    typename ActionT,
+    typename UCB_Functor,
+    typename Playout_Functor,
+    size_t MAX_DEPTH,
+    typename Strategy>
+void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::run_tree_parallel()
+{
+    const size_t n_helpers = m_config.n_threads - 1;
+    if (!m_pool || m_pool->size() != n_helpers) {
+        m_pool = std::make_unique<::utils::ThreadPool>(n_helpers);
+    }
+
+    std::atomic<int> shared_iterations { 0 };
+    p_shared_iterations = &shared_iterations;
+    m_tree.set_concurrent(true);
+
+    std::vector<std::unique_ptr<Mcts>> helpers;
+    std::vector<std::future<void>> searches;
+    helpers.reserve(n_helpers);
+    searches.reserve(n_helpers);
+
+    for (size_t i = 0; i < n_helpers; ++i) {
+        helpers.emplace_back(new Mcts(m_root_state, m_tree, UCB_Func));
+        auto& helper = helpers.back();
+        helper->m_config = m_config;
+        helper->m_config.n_threads = 1;
+        helper->backpropagation_strategy = backpropagation_strategy;
+        helper->n_players = n_players;
+        helper->p_shared_iterations = &shared_iterations;
+        helper->iteration_cnt = 0;
+        helper->m_stopwatch = m_stopwatch;
+        helper->m_deadline = m_deadline;
+        helper->m_stop_token = m_stop_token;
+        helper->p_extension = p_extension;
+    }
+
+    // The agents stop searching when the tree is full or needs compacting, and the
+    // nodes are evicted or compacted once they are all done before searching again.
+    while (true) {
+        for (auto& helper : helpers) {
+            searches.push_back(m_pool->submit([h = helper.get()] {
+                h->search();
+            }));
+        }
+
+        search();
+
+        for (auto& s : searches) {
+            s.get();
+        }
+        searches.clear();
+
+        if (needs_compaction() && !tree_full()) {
+            m_tree.set_concurrent(false);
+            compact_tree();
+            m_tree.set_concurrent(true);
+            continue;
+        }
+        if (!tree_full())
+            break;
+
+        m_tree.set_concurrent(false);
+        size_t n_evicted = evict_nodes();
+        m_tree.set_concurrent(true);
+        if (n_evicted == 0)
+            break;
     }
+    m_tree.set_concurrent(false);
+    p_shared_iterations = nullptr;
+
+    for (const auto& helper : helpers) {
+        iteration_cnt += helper->iteration_cnt;
+    }
+
+    return_to_root();
 }
 
 template <typename StateT,
     typename ActionT,
     typename UCB_Functor,
     typename Playout_Functor,
-    size_t MAX_DEPTH>
-inline void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH>::step()
+    size_t MAX_DEPTH,
+    typename Strategy>
+void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::run_leaf_parallel()
 {
+    const size_t n_helpers = m_config.n_threads - 1;
+    if (!m_pool || m_pool->size() != n_helpers) {
+        m_pool = std::make_unique<::utils::ThreadPool>(n_helpers);
+    }
+    m_playout_buffers.resize(n_helpers + 1, m_playout_buffers.front());
+
+    search();
+}
+
+template <typename StateT,
+    typename ActionT,
+    typename UCB_Functor,
+    typename Playout_Functor,
+    size_t MAX_DEPTH,
+    typename Strategy>
+inline void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::step()
+{
+    if (!m_tree.concurrent()) {
+        if (tree_full()) {
+            evict_nodes();
+        } else if (needs_compaction()) {
+            compact_tree();
+        }
+    }
     return_to_root();
     select_leaf();
     expand_current_node();
     backpropagate();
     ++iteration_cnt;
+    if (p_shared_iterations) {
+        p_shared_iterations->fetch_add(1, std::memory_order_relaxed);
+    }
 }
 
 template <typename StateT,
     typename ActionT,
     typename UCB_Functor,
     typename Playout_Functor,
-    size_t MAX_DEPTH>
-void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH>::select_leaf()
+    size_t MAX_DEPTH,
+    typename Strategy>
+void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::select_leaf()
 {
-    if (p_current_node->n_visits > 0 && p_current_node->children.empty())
+    if (m_tree.concurrent())
+    {
+        // The thread first visiting a leaf expands it, the others wait
+        // until its children are published.
+        while (m_tree.visit(p_current_node) > 0)
+        {
+            while (!Tree::is_published(p_current_node))
+                std::this_thread::yield();
+
+            // Transpositions may close cycles, so the descent also stops when the traversal is full.
+            if (m_tree.children(p_current_node).empty() || m_traversal.depth == MAX_DEPTH)
+                return;
+
+            edge_pointer edge = get_best_edge<ActionSelection::by_ucb>();
+
+            if (!traverse_edge(edge))
+                return;
+        }
+        return;
+    }
+
+    if (p_current_node->n_visits > 0 && m_tree.children(p_current_node).empty())
     {
         ++p_current_node->n_visits;
         return;
     }
 
-    while (p_current_node->n_visits > 0 && !p_current_node->children.empty())
+    while (p_current_node->n_visits > 0 && !m_tree.children(p_current_node).empty())
     {
+        // The node is expanded further instead, or the traversal is full
+        // (transpositions may close cycles).
+        if (can_widen(p_current_node) || m_traversal.depth == MAX_DEPTH)
+            return;
+
         ++p_current_node->n_visits;
-        edge_pointer edge = get_best_edge(ActionSelection::by_ucb);
+        edge_pointer edge = get_best_edge<ActionSelection::by_ucb>();
 
-        traverse_edge(edge);
+        if (defers_node(edge)) {
+            p_deferred_edge = edge;
+            return;
+        }
+        if (!traverse_edge(edge))
+            return;
     }
 }
 
@@ -147,28 +609,83 @@ template <typename StateT,
     typename ActionT,
     typename UCB_Functor,
     typename Playout_Functor,
-    size_t MAX_DEPTH>
-typename Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH>::edge_pointer
-Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH>::get_best_edge(
+    size_t MAX_DEPTH,
+    typename Strategy>
+typename Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::edge_pointer
+Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::get_best_edge(
     ActionSelection method)
 {
-    auto cmp = [&](const auto& a, const auto& b) {
-        if (method == ActionSelection::by_ucb) {
-            auto ucb = UCB_Func( m_config.exploration_constant,
-                p_current_node->n_visits );
-            return ucb(a) < ucb(b);
-        }
-        if (method == ActionSelection::by_n_visits)
-            return a.n_visits < b.n_visits;
+    if (m_config.solver) {
+        if (edge_pointer edge = get_proven_edge(method))
+            return edge;
+    }
 
-        if (method == ActionSelection::by_avg_value)
-            return a.total_val / (a.n_visits + 1.0) < b.total_val / (b.n_visits + 1.0);
+    switch (method) {
+    case ActionSelection::by_ucb:
+        return get_best_edge<ActionSelection::by_ucb>();
+    case ActionSelection::by_n_visits:
+        return get_best_edge<ActionSelection::by_n_visits>();
+    case ActionSelection::by_avg_value:
+        return get_best_edge<ActionSelection::by_avg_value>();
+    case ActionSelection::by_best_value:
+        break;
+    }
+    return get_best_edge<ActionSelection::by_best_value>();
+}
 
-        return a.best_val < b.best_val;
-    };
+template <typename StateT,
+    typename ActionT,
+    typename UCB_Functor,
+    typename Playout_Functor,
+    size_t MAX_DEPTH,
+    typename Strategy>
+template <ActionSelection METHOD>
+typename Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::edge_pointer
+Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::get_best_edge()
+{
+    auto children = m_tree.children(p_current_node);
+    if (children.empty()) {
+        return nullptr;
+    }
 
-    auto& children = p_current_node->children;
-    auto it = std::max_element(children.begin(), children.end(), cmp);
+    using selection::load;
+    size_t best = 0;
+    if constexpr (METHOD == ActionSelection::by_ucb) {
+        // The solver skips the proven edges, unless they all are.
+        const bool skip = m_config.solver;
+        const int n_visits = load(p_current_node->n_visits);
+        if constexpr (selection::Has_exploration_weight<UCB_Functor>) {
+            best = selection::argmax_ucb(children,
+                UCB_Func.exploration_weight(m_config.exploration_constant, n_visits),
+                skip,
+                [this](const auto& e) { return selection_value(e); });
+        } else {
+            auto ucb = UCB_Func(m_config.exploration_constant, n_visits);
+            const bool own_values = !m_config.dag_values && !m_config.rave;
+            const bool concurrent = m_tree.concurrent();
+            best = selection::argmax(children, [this, &ucb, skip, own_values, concurrent](const auto& e) {
+                if (skip && load(e.subtree_completed))
+                    return -std::numeric_limits<double>::infinity();
+                if (own_values && !concurrent)
+                    return double(ucb(e));
+                // The functor reads the value off the edge.
+                edge_type blended = edge_snapshot(e);
+                if (!own_values)
+                    blended.total_val = selection_value(e) * (blended.n_visits + 1);
+                return double(ucb(blended));
+            });
+        }
+        if (load(children[best].subtree_completed)) {
+            best = selection::argmax(children, [](const auto& e) { return load(e.best_val); });
+        }
+    } else if constexpr (METHOD == ActionSelection::by_n_visits) {
+        best = selection::argmax(children, [](const auto& e) { return load(e.n_visits); });
+    } else if constexpr (METHOD == ActionSelection::by_avg_value) {
+        best = selection::argmax_ucb(children, 0.0, false, [this](const auto& e) { return edge_value(e); });
+    } else {
+        best = selection::argmax(children, [](const auto& e) { return load(e.best_val); });
+    }
+    auto it = children.begin() + best;
 
 #ifdef DEBUG_BEST_EDGE
     std::cerr << "\n\nAt node\n"
@@ -196,21 +713,100 @@ Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH>::get_best_edge(
               << std::endl;
 #endif
 
-    return (!children.empty() ? &*it : nullptr);
+    return &*it;
 }
 
 template <typename StateT,
     typename ActionT,
     typename UCB_Functor,
     typename Playout_Functor,
-    size_t MAX_DEPTH>
-typename StateT::reward_type
-Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH>::simulate_playout(
+    size_t MAX_DEPTH,
+    typename Strategy>
+inline typename StateT::reward_type
+Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::simulate_playout(
     const ActionT& action, int n_reps)
+{
+    return simulate_playout(action, n_reps, m_playout_buffers.front());
+}
+
+template <typename StateT,
+    typename ActionT,
+    typename UCB_Functor,
+    typename Playout_Functor,
+    size_t MAX_DEPTH,
+    typename Strategy>
+typename StateT::reward_type
+Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::simulate_playout(
+    const ActionT& action, int n_reps, Playout_buffers& buffers) const
+{
+    // Running mean and variance of the rollouts (Welford's algorithm).
+    reward_type mean = 0.0;
+    double m2 = 0.0;
+    const int n_max = std::max(1, n_reps);
+
+    for (int n = 1; n <= n_max; ++n) {
+        reward_type delta = run_playout(action, buffers) - mean;
+        mean += delta / n;
+        m2 += delta * (delta - delta / n);
+
+        // Stop early once the standard error of the mean is small enough.
+        if (m_config.rollout_tolerance > 0.0 && n >= 2
+            && std::sqrt(m2 / ((n - 1) * n)) < m_config.rollout_tolerance) {
+            break;
+        }
+    }
+
+    return mean;
+}
+
+template <typename StateT,
+    typename ActionT,
+    typename UCB_Functor,
+    typename Playout_Functor,
+    size_t MAX_DEPTH,
+    typename Strategy>
+typename StateT::reward_type
+Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::run_playout(
+    const ActionT& action, Playout_buffers& buffers) const
 {
     player_type player = m_state.side_to_move();
+    const bool record = recording_amaf();
+    if (record) {
+        note_amaf(buffers, player, action);
+    }
+
+    // When the playout functor can choose an action without playing it, every
+    // action is evaluated and then applied on a single copy of the state.
+    if constexpr (policies::Has_choose<Playout_Functor, ActionT>) {
+        StateT& sim = buffers.sim;
+        sim = m_state;
+        reward_type score = apply_and_evaluate(sim, action);
+
+        Playout_Functor Playout_Func { sim };
+
+        while (!sim.is_terminal()) {
+            const ActionT next = Playout_Func.choose();
+            if (record) {
+                note_amaf(buffers, sim.side_to_move(), next);
+            }
+            score += apply_and_evaluate(sim, next);
+        }
+
+        // The last player is the opponent of the side to move (not `~side_to_move()`,
+        // which is always true when the players are bools).
+        reward_type eval_terminal = StateT::evaluate_terminal(sim);
+        if (two_players() && sim.side_to_move() == player) {
+            eval_terminal = 1.0 - eval_terminal;
+        }
+        if (record) {
+            close_amaf_playout(buffers, score + eval_terminal);
+        }
+        return score + eval_terminal;
+    }
+
     // Backup the state, initialize local vars and apply the initial action.
-    StateT backup = m_state;
+    StateT& backup = buffers.backup;
+    backup = m_state;
     ActionT _action = action;
     reward_type score = 0.0;
 
@@ -227,7 +823,8 @@ Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH>::simulate_playout
               << action << '\n' << std::endl;
 #endif
     reward_type _sim_score = 0.0;
-    StateT _sim = backup;
+    StateT& _sim = buffers.sim;
+    _sim = backup;
 
     // NOTE: The Playout functor stores a reference to the state it's
     // passed in its constructor
@@ -236,13 +833,16 @@ Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH>::simulate_playout
     // NOTE: To evaluate actions returned by the Playout_Functor from the
     // state before applying the action. (Should be taken cared of inside
     // of Playout_Func ideally...)
-    StateT _sim_prev = _sim;
+    StateT& _sim_prev = buffers.sim_prev;
 
     while (!_sim.is_terminal())
     {
         _sim_prev = _sim;
         _action = Playout_Func();
         _sim_score += _sim_prev.evaluate(_action);
+        if (record) {
+            note_amaf(buffers, _sim_prev.side_to_move(), _action);
+        }
 #ifdef DEBUG_PLAYOUT
         std::cerr << _sim_prev << '\n'
                   << "Action: "
@@ -257,7 +857,7 @@ Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH>::simulate_playout
     // simulation.
     reward_type eval_terminal = StateT::evaluate_terminal(_sim);
 
-    if (~_sim.side_to_move() != player)  // Last_player = !_sim.side_to_move()
+    if (two_players() && _sim.side_to_move() == player)  // Last_player = !_sim.side_to_move()
     {
         eval_terminal = 1.0 - eval_terminal;
     }
@@ -270,6 +870,9 @@ Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH>::simulate_playout
               << "\n############# END OF PLAYOUT #############\n" << std::endl;
 #endif
 
+    if (record) {
+        close_amaf_playout(buffers, _sim_score + eval_terminal);
+    }
     return _sim_score + eval_terminal;
 }
 
@@ -277,32 +880,250 @@ template <typename StateT,
     typename ActionT,
     typename UCB_Functor,
     typename Playout_Functor,
-    size_t MAX_DEPTH>
-void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH>::expand_current_node()
+    size_t MAX_DEPTH,
+    typename Strategy>
+void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::prepare_amaf(
+    std::span<const edge_type> leaf_edges)
+{
+    if constexpr (has_amaf) {
+        m_amaf_keys.clear();
+        for (size_t d = 0; d < m_traversal.depth; ++d) {
+            for (const auto& e : m_tree.children(m_traversal.nodes[d])) {
+                m_amaf_keys.emplace_back(e.player, e.action);
+            }
+        }
+        for (const auto& e : leaf_edges) {
+            m_amaf_keys.emplace_back(e.player, e.action);
+        }
+        std::ranges::sort(m_amaf_keys);
+        const auto duplicates = std::ranges::unique(m_amaf_keys);
+        m_amaf_keys.erase(duplicates.begin(), duplicates.end());
+
+        for (auto& buffers : m_playout_buffers) {
+            buffers.amaf.assign(m_amaf_keys.size(), Amaf_stat {});
+            buffers.amaf_played.clear();
+            buffers.amaf_n_playouts = 0;
+            buffers.amaf_total_val = 0.0;
+        }
+    }
+}
+
+template <typename StateT,
+    typename ActionT,
+    typename UCB_Functor,
+    typename Playout_Functor,
+    size_t MAX_DEPTH,
+    typename Strategy>
+inline void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::note_amaf(
+    Playout_buffers& buffers, player_type player, const ActionT& action) const
+{
+    if constexpr (has_amaf) {
+        const Amaf_key key { player, action };
+        const auto it = std::ranges::lower_bound(m_amaf_keys, key);
+        if (it == m_amaf_keys.end() || *it != key)
+            return;
+
+        // Only the first time the action is played counts.
+        const size_t i = it - m_amaf_keys.begin();
+        if (buffers.amaf[i].last_playout != buffers.amaf_n_playouts) {
+            buffers.amaf[i].last_playout = buffers.amaf_n_playouts;
+            buffers.amaf_played.push_back(i);
+        }
+    }
+}
+
+template <typename StateT,
+    typename ActionT,
+    typename UCB_Functor,
+    typename Playout_Functor,
+    size_t MAX_DEPTH,
+    typename Strategy>
+void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::close_amaf_playout(
+    Playout_buffers& buffers, reward_type reward) const
+{
+    if constexpr (has_amaf) {
+        const player_type player = m_state.side_to_move();
+        for (size_t i : buffers.amaf_played) {
+            auto& stat = buffers.amaf[i];
+            stat.val += two_players() && m_amaf_keys[i].first != player ? 1.0 - reward : reward;
+            ++stat.count;
+        }
+        buffers.amaf_played.clear();
+        ++buffers.amaf_n_playouts;
+        buffers.amaf_total_val += reward;
+    }
+}
+
+template <typename StateT,
+    typename ActionT,
+    typename UCB_Functor,
+    typename Playout_Functor,
+    size_t MAX_DEPTH,
+    typename Strategy>
+void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::update_amaf()
+{
+    if constexpr (has_amaf) {
+        // Gather the playouts of all the threads.
+        int n_playouts = 0;
+        reward_type total_val = 0.0;
+        for (const auto& buffers : m_playout_buffers) {
+            n_playouts += buffers.amaf_n_playouts;
+            total_val += buffers.amaf_total_val;
+        }
+        if (n_playouts == 0)
+            return;
+
+        const player_type player = m_state.side_to_move();
+        const size_t depth = m_traversal.depth;
+        for (size_t d = 0; d <= depth; ++d) {
+            node_type* node = d < depth ? m_traversal.nodes[d] : p_current_node;
+            const auto below = std::span(m_traversal.edges.begin() + d, m_traversal.edges.begin() + depth);
+
+            for (auto& e : m_tree.children(node)) {
+                const bool in_tree = std::ranges::any_of(below, [&e](const edge_type* t) {
+                    return t->player == e.player && t->action == e.action;
+                });
+                if (in_tree) {
+                    const reward_type val = two_players() && e.player != player ? n_playouts - total_val : total_val;
+                    m_tree.add_amaf(&e, val, n_playouts);
+                    continue;
+                }
+
+                const size_t i = std::ranges::lower_bound(m_amaf_keys, Amaf_key { e.player, e.action }) - m_amaf_keys.begin();
+                reward_type val = 0.0;
+                int count = 0;
+                for (const auto& buffers : m_playout_buffers) {
+                    val += buffers.amaf[i].val;
+                    count += buffers.amaf[i].count;
+                }
+                if (count > 0) {
+                    m_tree.add_amaf(&e, val, count);
+                }
+            }
+        }
+    }
+}
+
+template <typename StateT,
+    typename ActionT,
+    typename UCB_Functor,
+    typename Playout_Functor,
+    size_t MAX_DEPTH,
+    typename Strategy>
+inline typename StateT::reward_type
+Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::apply_and_evaluate(
+    StateT& state, const ActionT& action)
 {
-    auto valid_actions = m_state.valid_actions();
+    if constexpr (requires { { state.apply_and_evaluate(action) } -> std::convertible_to<reward_type>; }) {
+        return state.apply_and_evaluate(action);
+    } else {
+        reward_type ret = state.evaluate(action);
+        state.apply_action(action);
+        return ret;
+    }
+}
+
+template <typename StateT,
+    typename ActionT,
+    typename UCB_Functor,
+    typename Playout_Functor,
+    size_t MAX_DEPTH,
+    typename Strategy>
+void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::expand_current_node()
+{
+    // When searching concurrently, the visit was counted in `select_leaf()`
+    // and only the thread which claimed the leaf gets here with an unexpanded node.
+    if (m_tree.concurrent() && p_current_node->expanded)
+        return;
+
+    m_playout_value.reset();
+    if (p_deferred_edge) {
+        simulate_deferred_edge();
+        return;
+    }
+
     const player_type player = m_state.side_to_move();
+    bool widened = false;
 
-    for (auto a : valid_actions) {
-        edge_type new_edge {
-            .action = a,
-            .player = player,
-        };
-        reward_type val = simulate_playout(a, m_config.n_rollouts);
-        new_edge.best_val = new_edge.total_val = val;
-        p_current_node->children.push_back(new_edge);
+    if (!p_current_node->expanded) {
+        auto valid_actions = m_state.valid_actions();
+        if (widening()) {
+            // Open the most promising actions first.
+            m_action_scores.resize(valid_actions.size());
+            for (size_t i = 0; i < valid_actions.size(); ++i) {
+                m_action_scores[i] = { m_state.evaluate(valid_actions[i]), i };
+            }
+            std::ranges::stable_sort(m_action_scores, std::ranges::greater {}, [](const auto& s) { return s.first; });
+        }
+
+        auto children = m_tree.allocate_children(p_current_node, valid_actions.size());
+        for (size_t i = 0; i < valid_actions.size(); ++i) {
+            children[i] = edge_type {
+                .action = valid_actions[widening() ? m_action_scores[i].second : i],
+                .player = player,
+            };
+        }
+        p_current_node->n_children = 0;
+    } else if (p_current_node->n_children < p_current_node->n_actions) {
+        // Progressive widening of a node reached again: the value of the
+        // iteration is the one of the child opened.
+        widened = true;
     }
 
-    ++p_current_node->n_visits;
+    size_t n_open = widening() ? n_open_children(p_current_node) : p_current_node->n_actions;
+    // Even when the number of open children jumps by more than one, a single child
+    // is opened, so that the iteration backs up the value of all the playouts it ran.
+    // The others are opened by the next visits.
+    if (widened) {
+        n_open = std::min<size_t>(n_open, p_current_node->n_children + 1);
+    }
+    const auto new_edges = m_tree.all_children(p_current_node).subspan(p_current_node->n_children, n_open - p_current_node->n_children);
+
+    // Run the playouts of all new children on the thread pool, every thread
+    // with its own scratch states.
+    const bool leaf_parallel = m_config.parallelization == Parallelization::Leaf
+        && m_config.n_threads > 1
+        && m_playout_buffers.size() == size_t(m_config.n_threads)
+        && new_edges.size() > 1;
+
+    if (recording_amaf()) {
+        prepare_amaf(m_tree.all_children(p_current_node).subspan(0, n_open));
+    }
+
+    if (leaf_parallel) {
+        m_pool->parallel_for(new_edges.size(), [&](size_t i, size_t slot) {
+            new_edges[i].total_val = simulate_playout(new_edges[i].action, m_config.n_rollouts, m_playout_buffers[slot]);
+        });
+    } else {
+        for (auto& e : new_edges) {
+            e.total_val = simulate_playout(e.action, m_config.n_rollouts);
+        }
+    }
+    for (auto& e : new_edges) {
+        e.best_val = e.total_val;
+    }
+    if (widened) {
+        m_playout_value = new_edges.front().total_val;
+    }
+    p_current_node->n_children = n_open;
+
+    if (!m_tree.concurrent())
+        ++p_current_node->n_visits;
+
+    if (recording_amaf()) {
+        update_amaf();
+    }
+
+    Tree::publish(p_current_node);
 
 #ifdef DEBUG_EXPANSION
-        std::cerr << "\n\nExpanding the "
-              << valid_actions.size()
+        std::cerr << "\n\nExpanding "
+              << new_edges.size()
               << " children of\n"
               << m_state
               << "(Player: " << player << ")..."
               << "\nFound:\n";
-        for (const auto e : p_current_node->children)
+        for (const auto e : m_tree.children(p_current_node))
         {
             std::cerr << "Action " << e.action
                       << " Player " << e.player
@@ -318,84 +1139,299 @@ template <typename StateT,
     typename ActionT,
     typename UCB_Functor,
     typename Playout_Functor,
-    size_t MAX_DEPTH>
-void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH>::backpropagate()
+    size_t MAX_DEPTH,
+    typename Strategy>
+void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::simulate_deferred_edge()
+{
+    edge_pointer edge = std::exchange(p_deferred_edge, nullptr);
+
+    if (recording_amaf()) {
+        prepare_amaf(m_tree.children(p_current_node));
+    }
+    m_playout_value = simulate_playout(edge->action, m_config.n_rollouts);
+    if (recording_amaf()) {
+        update_amaf();
+    }
+
+    // The playouts are from the point of view of the current player,
+    // and go up the tree through the edge.
+    m_traversal.push(p_current_node, edge);
+}
+
+template <typename StateT,
+    typename ActionT,
+    typename UCB_Functor,
+    typename Playout_Functor,
+    size_t MAX_DEPTH,
+    typename Strategy>
+void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::backpropagate()
 {
     reward_type val = 0.0;
     player_type player_pov = m_state.side_to_move();
 
-    auto cmp_avg_val = [](const auto& a, const auto& b)
+    if (m_playout_value)
     {
-        return a.total_val/(1.0 + a.n_visits)
-            < b.total_val/(1.0 + b.n_visits);
-    };
-
-    if (m_state.is_terminal())
+        val = *m_playout_value;
+    }
+    else if (m_state.is_terminal())
     {
         val = evaluate_terminal();
 
-        if (m_tree.depth() > 0)
+        if (two_players() && m_traversal.depth > 0)
         {
-            val = m_tree.parent()->player != player_pov ? 1.0 - val : val;
+            val = m_traversal.parent()->player != player_pov ? 1.0 - val : val;
         }
-        // else
-        // {
-        //     val = 1.0 - val;
-        // }
     }
     else
     {
-        // Collect the best average reward amongst the current node's children
-        auto with_best_avg = std::max_element(p_current_node->children.begin(),
-                                              p_current_node->children.end(),
-                                              cmp_avg_val);
-
-        val = with_best_avg->total_val/(1.0 + with_best_avg->n_visits);
+        if constexpr (Strategy::is_static) {
+            val = children_value<Strategy::backpropagation>();
+        } else {
+            switch (backpropagation_strategy) {
+            case BackpropagationStrategy::avg_value:
+                val = children_value<BackpropagationStrategy::avg_value>();
+                break;
+            case BackpropagationStrategy::avg_best_value:
+                val = children_value<BackpropagationStrategy::avg_best_value>();
+                break;
+            case BackpropagationStrategy::best_value:
+                val = children_value<BackpropagationStrategy::best_value>();
+                break;
+            }
+        }
 
 #ifdef DEBUG_BACKPROPAGATION
-            std::cerr << "\n\nWe now backpropagate the best value we got from the simulations, "
+            std::cerr << "\n\nWe now backpropagate the value we got from the simulations, "
                   << "which is "
                   << std::setprecision(2)
                   << val
                   << std::endl;
 #endif
     }
-    
-    m_tree.backpropagate(val, player_pov);
+
+    if (m_config.solver && !m_tree.concurrent()) {
+        solve();
+    }
+
+    // Go back up to the root state while the statistics go up the tree.
+    if constexpr (has_undo) {
+        restore_root_state();
+    }
+
+    if (two_players())
+        m_tree.template backpropagate<true>(m_traversal, val, player_pov);
+    else
+        m_tree.template backpropagate<false>(m_traversal, val, player_pov);
+}
+
+template <typename StateT,
+    typename ActionT,
+    typename UCB_Functor,
+    typename Playout_Functor,
+    size_t MAX_DEPTH,
+    typename Strategy>
+template <BackpropagationStrategy STRATEGY>
+typename StateT::reward_type
+Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::children_value() const
+{
+    const auto children = m_tree.children(p_current_node);
+
+    if constexpr (STRATEGY == BackpropagationStrategy::avg_value) {
+        // The average over all the visits of the children.
+        reward_type total_val = 0.0;
+        double n_visits = 0.0;
+        for (const auto& e : children) {
+            total_val += selection::load(e.total_val);
+            n_visits += selection::load(e.n_visits) + 1.0;
+        }
+        return total_val / n_visits;
+    } else if constexpr (STRATEGY == BackpropagationStrategy::avg_best_value) {
+        // The best average amongst the children.
+        const auto value = [this](const auto& e) { return edge_value(e); };
+        return value(children[selection::argmax_ucb(children, 0.0, false, value)]);
+    } else {
+        // The best value amongst the children.
+        const auto best_val = [](const auto& e) { return selection::load(e.best_val); };
+        return best_val(children[selection::argmax(children, best_val)]);
+    }
+}
+
+template <typename StateT,
+    typename ActionT,
+    typename UCB_Functor,
+    typename Playout_Functor,
+    size_t MAX_DEPTH,
+    typename Strategy>
+void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::solve()
+{
+    const size_t depth = m_traversal.depth;
+    if (depth == 0 || !m_state.is_terminal()) {
+        return;
+    }
+
+    // The terminal evaluation is the reward of the last edge.
+    edge_pointer edge = m_traversal.edges[depth - 1];
+    std::optional<reward_type> value = evaluate_terminal();
+
+    for (size_t d = depth - 1;; --d) {
+        edge->subtree_completed = true;
+        edge->best_val = *value;
+        edge->total_val = *value * (edge->n_visits + 1);
+
+        if (d == 0) {
+            m_root_solved = proven_value(m_traversal.nodes[0], edge->player).has_value();
+            return;
+        }
+        edge = m_traversal.edges[d - 1];
+        value = proven_value(m_traversal.nodes[d], edge->player);
+        if (!value) {
+            return;
+        }
+    }
+}
+
+template <typename StateT,
+    typename ActionT,
+    typename UCB_Functor,
+    typename Playout_Functor,
+    size_t MAX_DEPTH,
+    typename Strategy>
+std::optional<typename Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::reward_type>
+Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::proven_value(const node_type* node, player_type player) const
+{
+    const auto children = m_tree.children(node);
+    if (children.empty()) {
+        return std::nullopt;
+    }
+
+    reward_type best = -std::numeric_limits<reward_type>::infinity();
+    // The actions not open yet (progressive widening) are still to try.
+    bool all_proven = node->n_children == node->n_actions;
+    for (const auto& e : children) {
+        if (!e.subtree_completed) {
+            all_proven = false;
+            continue;
+        }
+        best = std::max<reward_type>(best, e.best_val);
+    }
+    // A winning move or nothing left to try.
+    if (best < 1.0 && !all_proven) {
+        return std::nullopt;
+    }
+    if (two_players() && children.front().player != player) {
+        return 1.0 - best;
+    }
+    return best;
+}
+
+template <typename StateT,
+    typename ActionT,
+    typename UCB_Functor,
+    typename Playout_Functor,
+    size_t MAX_DEPTH,
+    typename Strategy>
+typename Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::edge_pointer
+Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::get_proven_edge(ActionSelection method)
+{
+    auto children = m_tree.children(p_current_node);
+    bool any_proven = false;
+    bool all_lost = true;
+    for (auto& e : children) {
+        if (!e.subtree_completed) {
+            all_lost = false;
+            continue;
+        }
+        any_proven = true;
+        if (e.best_val >= 1.0) {
+            return &e;
+        }
+        all_lost = all_lost && e.best_val <= 0.0;
+    }
+    if (!any_proven || all_lost) {
+        return nullptr;
+    }
+
+    // Hide the proven losses from the usual selection.
+    constexpr reward_type lost = -std::numeric_limits<reward_type>::infinity();
+    auto score = [method, lost](const auto& e) -> double {
+        if (e.subtree_completed && e.best_val <= 0.0)
+            return lost;
+        switch (method) {
+        case ActionSelection::by_n_visits:
+            return e.n_visits;
+        case ActionSelection::by_best_value:
+            return e.best_val;
+        default:
+            return e.total_val / (e.n_visits + 1.0);
+        }
+    };
+    return &children[selection::argmax(children, score)];
 }
 
 template <typename StateT,
     typename ActionT,
     typename UCB_Functor,
     typename Playout_Functor,
-    size_t MAX_DEPTH>
-void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH>::traverse_edge(
+    size_t MAX_DEPTH,
+    typename Strategy>
+bool Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::traverse_edge(
     edge_pointer edge)
 {
-    if (m_state.apply_action(edge->action))
+    // Once linked, the edge leads to its node without hashing the state: start
+    // fetching the node while the action is applied.
+    node_pointer child = m_tree.child(edge);
+    if (child)
+        __builtin_prefetch(child);
+
+    bool applied;
+    if constexpr (has_undo) {
+        auto& record = m_undo_stack[m_undo_depth];
+        applied = m_state.apply_action(edge->action, record.undo);
+        if (applied) {
+            record.action = edge->action;
+            ++m_undo_depth;
+        }
+    } else {
+        applied = m_state.apply_action(edge->action);
+    }
+
+    if (applied)
     {
-        m_tree.traversal_push(edge);
-        p_current_node = m_tree.get_node(m_state.key());
+        m_traversal.push(p_current_node, edge);
+        if (m_tree.concurrent())
+            Tree::add_virtual_loss(edge);
+        if (child) {
+            p_current_node = child;
+        } else {
+            p_current_node = m_tree.link(edge, m_state.key());
+        }
+        // And its children, which the selection reads next.
+        if (Tree::is_published(p_current_node) && p_current_node->n_children > 0)
+            __builtin_prefetch(m_tree.children(p_current_node).data());
     }
+    return applied;
 }
 
 template <typename StateT,
     typename ActionT,
     typename UCB_Functor,
     typename Playout_Functor,
-    size_t MAX_DEPTH>
-typename Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH>::ActionSequence
-Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH>::best_traversal(
+    size_t MAX_DEPTH,
+    typename Strategy>
+typename Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::ActionSequence
+Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::best_traversal(
     ActionSelection method)
 {
-    if (m_state != m_root_state) {
-        return_to_root();
-    }
+    // With undo, `backpropagate()` restores the root state but leaves the
+    // current node at the last leaf.
+    return_to_root();
 
     edge_pointer p_nex_edge;
-    while (p_current_node->n_visits > 0 && p_current_node->children.size() > 0) {
+    while (p_current_node->n_visits > 0 && m_tree.children(p_current_node).size() > 0
+        && m_traversal.depth < MAX_DEPTH) {
         p_nex_edge = get_best_edge(method);
-        traverse_edge(p_nex_edge);
+        if (!traverse_edge(p_nex_edge))
+            break;
 
         m_actions_done.push_back(p_nex_edge->action);
     }
@@ -404,11 +1440,12 @@ Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH>::best_traversal(
         return m_actions_done;
     }
 
-    ActionT action = m_state.apply_random_action();
-
-    while (!m_state.is_trivial(action)) {
-        m_actions_done.push_back(action);
-        action = m_state.apply_random_action();
+    // The random actions can't be undone.
+    m_state_on_path = false;
+    // Once the game is over, the random action is only a sentinel (e.g. -1 in Oware),
+    // which doesn't have to be trivial.
+    while (!m_state.is_terminal()) {
+        m_actions_done.push_back(m_state.apply_random_action());
     }
 
     return m_actions_done;
@@ -418,10 +1455,35 @@ template <typename StateT,
     typename ActionT,
     typename UCB_Functor,
     typename Playout_Functor,
-    size_t MAX_DEPTH>
-inline void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH>::return_to_root()
+    size_t MAX_DEPTH,
+    typename Strategy>
+inline void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::return_to_root()
 {
     p_current_node = m_tree.get_root();
+    m_traversal.clear();
+    restore_root_state();
+}
+
+template <typename StateT,
+    typename ActionT,
+    typename UCB_Functor,
+    typename Playout_Functor,
+    size_t MAX_DEPTH,
+    typename Strategy>
+inline void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::restore_root_state()
+{
+    if constexpr (has_undo) {
+        if (m_state_on_path) {
+            while (m_undo_depth > 0) {
+                --m_undo_depth;
+                const auto& record = m_undo_stack[m_undo_depth];
+                m_state.undo_action(record.action, record.undo);
+            }
+            return;
+        }
+        m_undo_depth = 0;
+        m_state_on_path = true;
+    }
     m_state = m_root_state;
 }
 
@@ -429,12 +1491,23 @@ template <typename StateT,
     typename ActionT,
     typename UCB_Functor,
     typename Playout_Functor,
-    size_t MAX_DEPTH>
-inline void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH>::apply_root_action(
+    size_t MAX_DEPTH,
+    typename Strategy>
+inline void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::apply_root_action(
     const ActionT& action)
 {
+    stop_background();
     m_root_state.apply_action(action);
-    m_tree.set_root(m_root_state.key());
+    m_state_on_path = false;
+
+    auto start = std::chrono::steady_clock::now();
+    auto [n_kept, n_freed] = m_tree.reroot(m_root_state);
+    m_reuse_stats.time += std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    m_reuse_stats.n_kept += n_kept;
+    m_reuse_stats.n_freed += n_freed;
+    ++m_reuse_stats.n_moves;
+
     return_to_root();
 
     m_actions_done.push_back(action);
@@ -444,32 +1517,261 @@ template <typename StateT,
     typename ActionT,
     typename UCB_Functor,
     typename Playout_Functor,
-    size_t MAX_DEPTH>
-inline bool Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH>::computation_resources()
+    size_t MAX_DEPTH,
+    typename Strategy>
+inline void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::reset(
+    const StateT& state)
 {
-    auto time = m_stopwatch();
-    bool time_ok = m_config.max_time > 0 ? time < m_config.max_time : true;
-    bool iterations_ok = m_config.max_iterations > 0 ? iteration_cnt < m_config.max_iterations : true;
-    return time_ok && iterations_ok;
+    stop_background();
+    m_root_state = state;
+    m_state_on_path = false;
+    m_tree.clear(m_root_state.key());
+    m_actions_done.clear();
+    m_reuse_stats = Reuse_stats {};
+    m_n_evicted = 0;
+    return_to_root();
+}
+
+template <typename StateT,
+    typename ActionT,
+    typename UCB_Functor,
+    typename Playout_Functor,
+    size_t MAX_DEPTH,
+    typename Strategy>
+void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::start_ponder()
+{
+    if (pondering()) {
+        return;
+    }
+    stop_background();
+    init_counters();
+    return_to_root();
+    // Nothing to search from a terminal root.
+    if (p_current_node->n_visits > 0 && m_tree.children(p_current_node).size() == 0) {
+        return;
+    }
+    m_pondering = true;
+    m_background = std::jthread([this](std::stop_token stop) {
+        while (!stop.stop_requested()) {
+            step();
+        }
+    });
+}
+
+template <typename StateT,
+    typename ActionT,
+    typename UCB_Functor,
+    typename Playout_Functor,
+    size_t MAX_DEPTH,
+    typename Strategy>
+void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::stop_ponder()
+{
+    if (pondering()) {
+        stop_background();
+    }
+}
+
+template <typename StateT,
+    typename ActionT,
+    typename UCB_Functor,
+    typename Playout_Functor,
+    size_t MAX_DEPTH,
+    typename Strategy>
+void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::stop_background()
+{
+    if (!m_background.joinable()) {
+        return;
+    }
+    m_background.request_stop();
+    m_background.join();
+    if (m_pondering) {
+        m_ponder_iterations = iteration_cnt;
+        m_pondering = false;
+    }
+    return_to_root();
+}
+
+template <typename StateT,
+    typename ActionT,
+    typename UCB_Functor,
+    typename Playout_Functor,
+    size_t MAX_DEPTH,
+    typename Strategy>
+inline bool Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::computation_resources()
+{
+    const auto budget = time_budget();
+    bool time_ok = budget.count() > 0 ? !m_deadline.expired(budget) : true;
+    // During a root parallel search, the iteration budget is shared by all the trees
+    // (so it can be overshot by at most `n_threads - 1` iterations).
+    int n_iterations = p_shared_iterations
+        ? p_shared_iterations->load(std::memory_order_relaxed)
+        : iteration_cnt;
+    const int max_iterations = m_config.max_iterations + p_extension->n_iterations.load(std::memory_order_relaxed);
+    bool iterations_ok = m_config.max_iterations > 0 ? n_iterations < max_iterations : true;
+    // In a tree parallel search, the nodes can only be evicted once all agents have stopped.
+    bool memory_ok = !(m_tree.concurrent() && (tree_full() || needs_compaction()));
+    return time_ok && iterations_ok && memory_ok
+        && !m_root_decided && !m_root_solved && !m_stop_token.stop_requested();
+}
+
+template <typename StateT,
+    typename ActionT,
+    typename UCB_Functor,
+    typename Playout_Functor,
+    size_t MAX_DEPTH,
+    typename Strategy>
+inline ::utils::Deadline::Duration Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::time_budget() const
+{
+    using std::chrono::microseconds;
+    using std::chrono::milliseconds;
+
+    microseconds budget = m_config.max_time_us > 0
+        ? microseconds(m_config.max_time_us)
+        : milliseconds(m_config.max_time);
+    if (m_root_unstable) {
+        budget = std::max<microseconds>(budget, milliseconds(m_config.max_time_stretch));
+    }
+    if (budget.count() > 0) {
+        budget += milliseconds(p_extension->time.load(std::memory_order_relaxed));
+    }
+    return budget;
+}
+
+template <typename StateT,
+    typename ActionT,
+    typename UCB_Functor,
+    typename Playout_Functor,
+    size_t MAX_DEPTH,
+    typename Strategy>
+void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::check_root()
+{
+    const auto children = m_tree.children(m_tree.get_root());
+    if (children.empty()) {
+        return;
+    }
+    if (m_config.stop_when_decided && children.size() == 1) {
+        m_root_decided = true;
+        return;
+    }
+
+    // The two most visited edges.
+    size_t best = 0;
+    int n_first = -1;
+    int n_second = -1;
+    for (size_t i = 0; i < children.size(); ++i) {
+        const int n = selection::load(children[i].n_visits);
+        if (n > n_first) {
+            n_second = n_first;
+            n_first = n;
+            best = i;
+        } else if (n > n_second) {
+            n_second = n;
+        }
+    }
+
+    m_root_unstable = (m_config.max_time_stretch > 0)
+        && (m_root_best != children[best].action || selection::argmax_ucb(children, 0.0, false, [this](const auto& e) { return edge_value(e); }) != best);
+    m_root_best = children[best].action;
+
+    if (!m_config.stop_when_decided) {
+        return;
+    }
+
+    // The iterations left in the budgets, the time one extrapolated from the rate so far.
+    const int n_iterations = p_shared_iterations
+        ? p_shared_iterations->load(std::memory_order_relaxed)
+        : iteration_cnt;
+    double n_left = -1.0;
+    if (m_config.max_iterations > 0) {
+        n_left = m_config.max_iterations
+            + p_extension->n_iterations.load(std::memory_order_relaxed)
+            - n_iterations;
+    }
+    const auto budget = time_budget();
+    const auto elapsed = m_deadline.elapsed();
+    if (budget.count() > 0 && elapsed.count() > 0) {
+        const double n_time_left = double(n_iterations) * (budget - elapsed).count() / elapsed.count();
+        n_left = n_left < 0.0 ? n_time_left : std::min(n_left, n_time_left);
+    }
+    m_root_decided = n_left >= 0.0 && n_first - n_second > n_left;
+}
+
+template <typename StateT,
+    typename ActionT,
+    typename UCB_Functor,
+    typename Playout_Functor,
+    size_t MAX_DEPTH,
+    typename Strategy>
+inline bool Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::tree_full() const
+{
+    return m_config.max_nodes > 0 && m_tree.size() >= m_config.max_nodes;
+}
+
+template <typename StateT,
+    typename ActionT,
+    typename UCB_Functor,
+    typename Playout_Functor,
+    size_t MAX_DEPTH,
+    typename Strategy>
+inline bool Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::needs_compaction() const
+{
+    if (m_config.compaction_growth <= 0.0 || m_tree.size() < min_compaction_size)
+        return false;
+
+    return m_tree.size() > (1.0 + m_config.compaction_growth) * m_tree.compacted_size();
+}
+
+template <typename StateT,
+    typename ActionT,
+    typename UCB_Functor,
+    typename Playout_Functor,
+    size_t MAX_DEPTH,
+    typename Strategy>
+void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::compact_tree()
+{
+    m_tree.compact(m_root_state);
+    return_to_root();
+}
+
+template <typename StateT,
+    typename ActionT,
+    typename UCB_Functor,
+    typename Playout_Functor,
+    size_t MAX_DEPTH,
+    typename Strategy>
+size_t Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::evict_nodes()
+{
+    size_t n_evicted = m_tree.evict(m_root_state, m_config.max_nodes / 2);
+    m_n_evicted += n_evicted;
+    return_to_root();
+    return n_evicted;
 }
 
 template <typename StateT,
     typename ActionT,
     typename UCB_Functor,
     typename Playout_Functor,
-    size_t MAX_DEPTH>
-inline void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH>::init_counters()
+    size_t MAX_DEPTH,
+    typename Strategy>
+inline void Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::init_counters()
 {
     iteration_cnt = 0;
+    m_helper_nodes = 0;
+    m_root_best.reset();
+    m_root_unstable = false;
+    m_root_decided = false;
+    m_root_solved = m_config.solver && proven_value(m_tree.get_root(), player_type {}).has_value();
     m_stopwatch.reset_start();
+    m_deadline.reset_start();
 }
 
 template <typename StateT,
     typename ActionT,
     typename UCB_Functor,
     typename Playout_Functor,
-    size_t MAX_DEPTH>
-typename Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH>::reward_type inline Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH>::evaluate(const ActionT& action)
+    size_t MAX_DEPTH,
+    typename Strategy>
+typename Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::reward_type inline Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::evaluate(const ActionT& action)
 {
     return m_state.evaluate(action);
 }
@@ -478,8 +1780,9 @@ template <typename StateT,
     typename ActionT,
     typename UCB_Functor,
     typename Playout_Functor,
-    size_t MAX_DEPTH>
-typename Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH>::reward_type inline Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH>::evaluate_terminal(const StateT& state) const
+    size_t MAX_DEPTH,
+    typename Strategy>
+typename Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::reward_type inline Mcts<StateT, ActionT, UCB_Functor, Playout_Functor, MAX_DEPTH, Strategy>::evaluate_terminal(const StateT& state) const
 {
     return state.evaluate_terminal();
 }
@@ -2,20 +2,131 @@
 #define __MCTSTREE_H_
 
 #include <algorithm>
-#include <deque>
+#include <array>
+#include <atomic>
+#include <concepts>
+#include <cstdint>
+#include <functional>
 #include <iomanip>
 #include <iostream>
 #include <iterator>
+#include <limits>
+#include <mutex>
+#include <shared_mutex>
+#include <span>
 #include <sstream>
 #include <string>
-#include <unordered_map>
+#include <thread>
 #include <vector>
 
+#include "transposition_table.h"
+#include "utils/arena.h"
+
 namespace mcts {
 
 template <typename StateT, typename ActionT, size_t MAX_DEPTH>
 class MctsTree;
 
+/**
+ * An action stored as a smaller integer code, which it converts to and from
+ * with `static_cast`.
+ */
+template <typename ActionT, typename CodeT>
+struct Packed_action {
+    CodeT code;
+
+    Packed_action() = default;
+    Packed_action(const ActionT& action)
+        : code(static_cast<CodeT>(action))
+    {
+    }
+    operator ActionT() const
+    {
+        return static_cast<ActionT>(code);
+    }
+
+    friend bool operator==(const Packed_action&, const Packed_action&) = default;
+    friend bool operator==(const Packed_action& packed, const ActionT& action)
+    {
+        return ActionT(packed) == action;
+    }
+    friend std::ostream& operator<<(std::ostream& _out, const Packed_action& packed)
+    {
+        return _out << ActionT(packed);
+    }
+};
+
+/**
+ * A state can make the nodes and edges of its tree more compact by declaring
+ *
+ * - `tree_value_type`, the type of the rewards summed up by the tree (e.g. `float`
+ *   instead of a `double` reward_type),
+ * - `action_code_type`, an integer type smaller than `ActionT` holding the actions
+ *   of the edges (see `Packed_action`).
+ *
+ * @Note A `float` sum of rewards in [0, 1] stops counting single rewards after
+ * 2^24 of them, far more visits than an edge ever gets.
+ */
+template <typename StateT>
+struct Tree_value {
+    using type = typename StateT::reward_type;
+};
+template <typename StateT>
+    requires requires { typename StateT::tree_value_type; }
+struct Tree_value<StateT> {
+    using type = typename StateT::tree_value_type;
+};
+
+template <typename StateT, typename ActionT>
+struct Edge_action {
+    using type = ActionT;
+};
+template <typename StateT, typename ActionT>
+    requires requires { typename StateT::action_code_type; }
+struct Edge_action<StateT, ActionT> {
+    using type = Packed_action<ActionT, typename StateT::action_code_type>;
+};
+
+/**
+ * The all-moves-as-first statistics of an edge (see `Config::rave`), only held by the
+ * edges of a state declaring `static constexpr bool amaf_statistics = true`, so that
+ * the trees searched without RAVE don't pay for them.
+ *
+ * `val` and `visits` sum the rewards and count the playouts where the edge's player
+ * played its action anywhere below the edge's node.
+ */
+template <bool AMAF>
+struct Edge_amaf {
+};
+template <>
+struct Edge_amaf<true> {
+    float val = 0;
+    int visits = 0;
+};
+
+template <typename StateT>
+constexpr bool amaf_statistics = false;
+template <typename StateT>
+    requires requires { { StateT::amaf_statistics } -> std::convertible_to<bool>; }
+constexpr bool amaf_statistics<StateT> = StateT::amaf_statistics;
+
+/**
+ * A state whose positions never have more than `StateT::max_branching` valid actions
+ * gets the children of its nodes stored inline in the nodes: expanding a node then
+ * allocates nothing, and the edges lie right next to the node's statistics.
+ *
+ * @Note Every node then holds `max_branching` edges, leaves included, so this only
+ * pays off for games with a small branching factor, with the compact layout (see
+ * `Tree_value` and `Edge_action`) or when the leaves are not materialized (see
+ * `Config::materialization_threshold`). A node with more valid actions still gets
+ * its edges from the edge arena.
+ */
+template <typename StateT>
+constexpr size_t max_branching = 0;
+template <typename StateT>
+    requires requires { { StateT::max_branching } -> std::convertible_to<size_t>; }
+constexpr size_t max_branching<StateT> = StateT::max_branching;
+
 template <typename StateT, typename ActionT, size_t MAX_DEPTH>
 std::ostream& operator<<(std::ostream&, const MctsTree<StateT, ActionT, MAX_DEPTH>&);
 
@@ -26,22 +137,105 @@ public:
     struct Edge;
     using node_pointer = Node*;
     using edge_pointer = Edge*;
-    using ChildrenContainer = std::vector<Edge>;
+    using ChildrenContainer = std::span<Edge>;
     using key_type = typename StateT::key_type;
     using reward_type = typename StateT::reward_type;
     using player_type = typename StateT::player_type;
+    using value_type = typename Tree_value<StateT>::type;
+    using action_storage = typename Edge_action<StateT, ActionT>::type;
+    using index_type = ::utils::Arena_index;
+    static constexpr size_t inline_capacity = max_branching<StateT>;
+    static constexpr bool has_amaf = amaf_statistics<StateT>;
+    /** The `child` of an edge which doesn't lead to a node. */
+    static constexpr index_type no_node = std::numeric_limits<index_type>::max();
+    /**
+     * @Note When the solver proves the value of an edge, `subtree_completed` is set,
+     * `best_val` holds the exact value and the average value is kept equal to it.
+     * @Note `child` is the index of the node the edge leads to in the tree's table (see
+     * `child()`), set when the edge is first traversed. It is `no_node` for an edge which
+     * was never traversed or whose child node was evicted. The later traversals follow
+     * it instead of looking the state up in the table.
+     * @Note The small fields come first, so that they share a word with `n_visits`, and
+     * the 32-bit `child` index fills the rest of the word before the values.
+     */
+    struct Edge {
+        action_storage action;
+        player_type player;
+        bool subtree_completed = false;
+        int n_visits = 0;
+        index_type child = no_node;
+        value_type total_val = 0;
+        value_type best_val = 0;
+        [[no_unique_address]] Edge_amaf<has_amaf> amaf {};
+    };
+    /**
+     * The children of a node are the `n_children` contiguous edges starting at
+     * index `first_child` of the tree's edge arena (see `children()`), or the first
+     * `n_children` of `inline_children` when they fit there.
+     *
+     * @Note With progressive widening, the edges of all the `n_actions` valid actions
+     * are allocated at once, but only the first `n_children` of them are open to the
+     * search (see `all_children()`).
+     *
+     * @Note Since nodes are shared by all the paths leading to their state, `total_val`
+     * and `n_backups` gather the rewards backpropagated through the node from any of
+     * its parents, from the point of view of `player` (the player of the first edge
+     * linked to it, see `link()`).
+     */
     struct Node {
         key_type key;
-        int n_visits;
-        ChildrenContainer children;
+        value_type total_val = 0;
+        int n_visits = 0;
+        int n_backups = 0;
+        index_type first_child = 0;
+        index_type n_children = 0;
+        index_type n_actions = 0;
+        /** Set once the children are populated, so that concurrent searchers can read them. */
+        bool expanded = false;
+        player_type player {};
+        [[no_unique_address]] std::array<Edge, inline_capacity> inline_children {};
     };
-    struct Edge {
-        ActionT action;
-        player_type player;
-        reward_type total_val;
-        reward_type best_val;
-        int n_visits;
-        bool subtree_completed;
+
+    /**
+     * The edges leading from the root to the current node of a search.
+     *
+     * Every searcher owns its own traversal, so that many of them can walk
+     * the same tree at once.
+     */
+    struct Traversal {
+        std::array<edge_pointer, MAX_DEPTH> edges;
+        /** The node each edge leaves from. */
+        std::array<node_pointer, MAX_DEPTH> nodes;
+        size_t depth;
+
+        void push(node_pointer node, edge_pointer edge)
+        {
+            nodes[depth] = node;
+            edges[depth] = edge;
+            ++depth;
+        }
+        void clear()
+        {
+            depth = 0;
+        }
+        edge_pointer parent() const
+        {
+            if (depth == 0)
+                return nullptr;
+
+            return edges[depth - 1];
+        }
+        std::vector<ActionT> traceback() const
+        {
+            std::vector<ActionT> ret;
+            std::transform(edges.begin(),
+                edges.begin() + depth,
+                std::back_inserter(ret),
+                [](auto* e) {
+                    return e->action;
+                });
+            return ret;
+        }
     };
 
     MctsTree(key_type);
@@ -49,7 +243,6 @@ public:
     void set_root(const key_type key)
     {
         p_root = get_node(key);
-        m_depth = 0;
     }
     node_pointer get_root() const
     {
@@ -57,17 +250,134 @@ public:
     }
     node_pointer get_node(const key_type key)
     {
-        auto [node_it, inserted] = m_table.insert(std::pair { key, Node {
-                                                                       .key = key,
-                                                                   } });
-        return &(node_it->second);
+        return &table().at(get_node_index(key));
     }
-    void traversal_push(edge_pointer edge)
+
+    /**
+     * When set, the tree is searched by many threads at once: nodes are looked up
+     * under a lock, and the statistics are updated atomically with a virtual loss
+     * (see `add_virtual_loss()`).
+     *
+     * @Note The statistics are read without locking, with relaxed atomic loads (see
+     * `selection::load()`), so a reader may see slightly stale values but never a
+     * torn one (this is the lock-free tree parallelization of Enzenberger and Müller).
+     * Every read of a statistic which may run during a concurrent search must go
+     * through such a load, as a plain read racing with the updates is undefined.
+     */
+    void set_concurrent(bool concurrent)
+    {
+        m_concurrent = concurrent;
+    }
+    bool concurrent() const
+    {
+        return m_concurrent;
+    }
+
+    /**
+     * Count a visit with no reward on an edge as soon as it is selected, so that
+     * the other threads are discouraged from following the same path. The visit
+     * then becomes a real one when the reward is backpropagated.
+     */
+    static void add_virtual_loss(edge_pointer edge)
+    {
+        std::atomic_ref(edge->n_visits).fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * Increment the number of visits of a node and return the previous count.
+     */
+    int visit(node_pointer node)
+    {
+        if (m_concurrent)
+            return std::atomic_ref(node->n_visits).fetch_add(1, std::memory_order_relaxed);
+
+        return node->n_visits++;
+    }
+
+    /**
+     * Mark the node's children as ready to be read by the other threads.
+     */
+    static void publish(node_pointer node)
+    {
+        std::atomic_ref(node->expanded).store(true, std::memory_order_release);
+    }
+    static bool is_published(node_pointer node)
+    {
+        return std::atomic_ref(node->expanded).load(std::memory_order_acquire);
+    }
+
+    /**
+     * Add `n` playouts whose rewards sum to `val` to the AMAF statistics of the edge.
+     */
+    void add_amaf(edge_pointer edge, reward_type val, int n)
+        requires has_amaf
     {
-        m_edge_stack[m_depth] = edge;
-        ++m_depth;
+        if (m_concurrent) {
+            std::atomic_ref(edge->amaf.val).fetch_add(float(val), std::memory_order_relaxed);
+            std::atomic_ref(edge->amaf.visits).fetch_add(n, std::memory_order_relaxed);
+            return;
+        }
+        edge->amaf.val += float(val);
+        edge->amaf.visits += n;
+    }
+
+    /**
+     * The node the edge leads to, or nullptr if it was not linked yet (see `link()`).
+     */
+    node_pointer child(const Edge* edge) const
+    {
+        const index_type index = m_concurrent
+            ? std::atomic_ref(const_cast<Edge*>(edge)->child).load(std::memory_order_acquire)
+            : edge->child;
+        return index == no_node ? nullptr : const_cast<Node*>(&table().at(index));
+    }
+
+    /**
+     * Point the edge to the node of the given key, inserting the node first if needed,
+     * and return the node. A node with no value yet starts from the edge's statistics
+     * and point of view, so that without transpositions its value stays the edge's
+     * average value.
+     *
+     * @Note When searching concurrently, the first edge linked to a node claims it and
+     * sets its value and point of view before any edge points to it, so the threads
+     * reaching the node through an edge (see `child()`) never see them change.
+     */
+    node_pointer link(edge_pointer edge, const key_type key)
+    {
+        const index_type index = get_node_index(key);
+        node_pointer child = &table().at(index);
+        if (m_concurrent) {
+            std::atomic_ref n_backups(child->n_backups);
+            int no_backups = 0;
+            if (n_backups.compare_exchange_strong(no_backups, claimed, std::memory_order_acquire)) {
+                child->player = edge->player;
+                child->total_val = std::atomic_ref(edge->total_val).load(std::memory_order_relaxed);
+                // The edge's visits already count the virtual loss of the current traversal.
+                n_backups.store(std::atomic_ref(edge->n_visits).load(std::memory_order_relaxed), std::memory_order_release);
+            } else {
+                while (n_backups.load(std::memory_order_acquire) == claimed)
+                    std::this_thread::yield();
+            }
+            std::atomic_ref(edge->child).store(index, std::memory_order_release);
+            return child;
+        }
+        edge->child = index;
+        if (child->n_backups == 0) {
+            child->player = edge->player;
+            child->total_val = edge->total_val;
+            child->n_backups = edge->n_visits + 1;
+        }
+        return child;
     }
-    void backpropagate(reward_type reward, player_type player = player_type{})
+
+    /**
+     * Add the reward to all the edges of the traversal, and to the nodes they lead to.
+     *
+     * @Note With two players, the reward is flipped every time the player changes, so
+     * that each edge holds the value from the point of view of the player to act.
+     */
+    template <bool TWO_PLAYERS = true>
+    void backpropagate(Traversal& traversal, reward_type reward, player_type player = player_type{})
     {
 #ifdef DEBUG_BACKPROPAGATION
         std::cerr << "\n\n\nInside the tree, we update the stats of each edges above "
@@ -79,79 +389,351 @@ public:
                   << std::endl;
 #endif
 
-        while (m_depth > 0) {
+        auto& depth = traversal.depth;
+
+        while (depth > 0) {
 
 #ifdef DEBUG_BACKPROPAGATION
-            std::cerr << "\nDepth: " << m_depth
+            std::cerr << "\nDepth: " << depth
                       << ", Reward: " << reward
                       << std::endl;
 #endif
 
-            --m_depth;
+            --depth;
+            edge_pointer edge = traversal.edges[depth];
 
-            // If the edge flips the players, flip the reward
-            if (m_edge_stack[m_depth]->player != player) {
-                player = ~player;
+            // If the edge flips the players, flip the reward. (Not with `~player`,
+            // which is always true when the players are bools.)
+            if (TWO_PLAYERS && edge->player != player) {
+                player = edge->player;
                 reward = 1.0 - reward;
             }
 
-            m_edge_stack[m_depth]->total_val += reward;
-            ++m_edge_stack[m_depth]->n_visits;
+            node_pointer child = MctsTree::child(edge);
+            // The child node may be reached by the edges of another player too.
+            const reward_type child_reward = TWO_PLAYERS && child && child->player != player
+                ? 1.0 - reward
+                : reward;
+            if (m_concurrent) {
+                // The visit was already counted by the virtual loss.
+                std::atomic_ref(edge->total_val).fetch_add(reward, std::memory_order_relaxed);
+                if (child) {
+                    std::atomic_ref(child->total_val).fetch_add(child_reward, std::memory_order_relaxed);
+                    std::atomic_ref(child->n_backups).fetch_add(1, std::memory_order_relaxed);
+                }
+                continue;
+            }
+
+            edge->total_val += reward;
+            ++edge->n_visits;
+            if (edge->subtree_completed) {
+                edge->total_val = edge->best_val * (edge->n_visits + 1);
+            }
+            if (child) {
+                child->total_val += child_reward;
+                ++child->n_backups;
+            }
 
 #ifdef DEBUG_BACKPROPAGATION
-            std::cerr << "\nedge with player " << m_edge_stack[m_depth]->player << ':'
-                      << "\ntotal_val: " << m_edge_stack[m_depth]->total_val - reward
-                      << " --> " << m_edge_stack[m_depth]->total_val
-                      << "\nn_visits: " << m_edge_stack[m_depth]->n_visits - 1
-                      << " --> " << m_edge_stack[m_depth]->n_visits
+            std::cerr << "\nedge with player " << edge->player << ':'
+                      << "\ntotal_val: " << edge->total_val - reward
+                      << " --> " << edge->total_val
+                      << "\nn_visits: " << edge->n_visits - 1
+                      << " --> " << edge->n_visits
                       << std::endl;
 #endif
         }
     }
 
-    edge_pointer parent()
+    ChildrenContainer children(const Node* node)
+    {
+        if (node->n_children == 0)
+            return {};
+
+        return { first_edge(node), node->n_children };
+    }
+    const ChildrenContainer children(const Node* node) const
+    {
+        return const_cast<MctsTree*>(this)->children(node);
+    }
+
+    /**
+     * The edges of all the valid actions of a node, the open children first.
+     */
+    ChildrenContainer all_children(const Node* node)
+    {
+        if (node->n_actions == 0)
+            return {};
+
+        return { first_edge(node), node->n_actions };
+    }
+    const ChildrenContainer all_children(const Node* node) const
+    {
+        return const_cast<MctsTree*>(this)->all_children(node);
+    }
+
+    /**
+     * Carve `n` contiguous edges for the children of a node out of the edge arena.
+     *
+     * @Note The edges are left uninitialized, and all open.
+     */
+    ChildrenContainer allocate_children(node_pointer node, size_t n)
+    {
+        if (n > inline_capacity) {
+            std::unique_lock lock(m_mutex, std::defer_lock);
+            if (m_concurrent)
+                lock.lock();
+            node->first_child = edges().allocate(n);
+        }
+        node->n_children = n;
+        node->n_actions = n;
+        return children(node);
+    }
+
+    /**
+     * Release all the nodes and edges at once, and start a new tree at the given root.
+     */
+    void clear(const key_type key)
+    {
+        table().clear();
+        edges().clear();
+        p_root = get_node(key);
+        m_compacted_size = size();
+    }
+
+    struct Reroot_stats {
+        size_t n_kept;
+        size_t n_freed;
+    };
+
+    /**
+     * Make the node of the given state the new root, and release all the nodes
+     * which can't be reached from it anymore.
+     *
+     * The subtree under the new root is copied into the spare table and edge arena,
+     * which then become the active ones. The old storage is cleared in O(1) and kept
+     * around for the next call, so the memory of a long game stays bounded by the
+     * largest subtree instead of growing with every move.
+     */
+    Reroot_stats reroot(const StateT& root_state)
     {
-        if (m_depth == 0)
-            return nullptr;
+        const size_t n_before = size();
+        copy_reachable(root_state, 0);
+        table().reset_stats();
 
-        return m_edge_stack[m_depth - 1];
+        return { size(), n_before - std::min(n_before, size()) };
+    }
+
+    /**
+     * Lay the whole tree out again as in `reroot()`, keeping the same root.
+     */
+    void compact(const StateT& root_state)
+    {
+        copy_reachable(root_state, 0);
     }
 
-    std::vector<ActionT> traceback() const
+    /**
+     * The number of nodes the tree held when it was last compacted, rerooted or evicted.
+     */
+    size_t compacted_size() const
     {
-        std::vector<ActionT> ret;
-        std::transform(m_edge_stack.begin(),
-            m_edge_stack.begin() + m_depth,
-            std::back_inserter(ret),
-            [](auto* e) {
-                return e->action;
-            });
-        return ret;
+        return m_compacted_size;
+    }
+
+    /**
+     * Release the least visited nodes, so that at most `n_nodes` nodes are left.
+     *
+     * The nodes visited more often than the `n_nodes + 1`-th most visited one are
+     * kept as in `reroot()`, skipping the subtrees of all the others. The edges
+     * leading to an evicted node keep their statistics, and the node is simply
+     * expanded again if a search reaches it.
+     *
+     * @Note Return the number of nodes released.
+     */
+    size_t evict(const StateT& root_state, size_t n_nodes)
+    {
+        const size_t n_before = size();
+        if (n_before <= n_nodes)
+            return 0;
+
+        std::vector<int> visits;
+        visits.reserve(n_before);
+        table().for_each([&visits](const Node& node) {
+            visits.push_back(node.n_visits);
+        });
+        std::nth_element(visits.begin(), visits.begin() + n_nodes, visits.end(), std::greater<int>());
+
+        copy_reachable(root_state, visits[n_nodes] + 1);
+
+        return n_before - std::min(n_before, size());
     }
+
     size_t size() const
     {
-        return m_table.size();
+        return table().size();
     }
-    int depth() const
+    size_t bytes_reserved() const
     {
-        return m_depth;
+        return m_tables[0].bytes_reserved() + m_tables[1].bytes_reserved()
+            + m_edges[0].bytes_reserved() + m_edges[1].bytes_reserved();
     }
     void reserve(size_t sz)
     {
-        m_table.reserve(sz);
+        m_tables[0].reserve(sz);
+        m_tables[1].reserve(sz);
+    }
+    double load_factor() const
+    {
+        return table().load_factor();
+    }
+    typename TranspositionTable<key_type, Node>::Probe_stats probe_stats() const
+    {
+        return table().probe_stats();
     }
 
     friend std::ostream& operator<<<>(std::ostream&, const MctsTree<StateT, ActionT, MAX_DEPTH>&);
 
 private:
-    using LookupTable = typename std::unordered_map<key_type, Node>;
-    using TraversalStack = std::array<edge_pointer, MAX_DEPTH>;
+    using LookupTable = TranspositionTable<key_type, Node>;
 
-    LookupTable m_table;
-    TraversalStack m_edge_stack;
-    size_t m_depth;
+    // Two sets of storage, so that the subtree kept by `reroot()` can be copied
+    // out of the active one. Only `m_tables[m_active]` and `m_edges[m_active]`
+    // hold the tree, the other set is empty between two calls to `reroot()`.
+    std::array<LookupTable, 2> m_tables;
+    std::array<::utils::Arena<Edge>, 2> m_edges;
+    size_t m_active;
+    // The number of nodes right after the last call to `copy_reachable()`.
+    size_t m_compacted_size = 0;
+    std::shared_mutex m_mutex;
+    bool m_concurrent;
+    // The `n_backups` of a node while the first edge linked to it sets its value.
+    static constexpr int claimed = -1;
     Node* p_root;
 
+    LookupTable& table()
+    {
+        return m_tables[m_active];
+    }
+    const LookupTable& table() const
+    {
+        return m_tables[m_active];
+    }
+    ::utils::Arena<Edge>& edges()
+    {
+        return m_edges[m_active];
+    }
+    const ::utils::Arena<Edge>& edges() const
+    {
+        return m_edges[m_active];
+    }
+
+    /**
+     * Copy the nodes reachable from the root through nodes visited at least
+     * `min_visits` times into the spare storage, and make it the active one.
+     *
+     * The nodes and their edges are laid out in depth-first order, the most visited
+     * child first, so that the paths the selection walks the most lie in contiguous
+     * memory instead of in the order the nodes were inserted.
+     *
+     * @Note The root is always kept. The nodes are reached through the `child` links
+     * of the edges, which are set by every traversal: a node whose edges from the kept
+     * nodes were never traversed is released, and inserted again if a search reaches it.
+     */
+    void copy_reachable(const StateT& root_state, int min_visits)
+    {
+        LookupTable& from_table = table();
+        const size_t to = 1 - m_active;
+        LookupTable& to_table = m_tables[to];
+        ::utils::Arena<Edge>& to_edges = m_edges[to];
+
+        // The nodes to copy, with the copied edge leading to them.
+        std::vector<std::pair<const Node*, Edge*>> stack;
+        std::vector<std::pair<int, size_t>> order;
+        if (const Node* root = from_table.find(root_state.key())) {
+            stack.emplace_back(root, nullptr);
+        }
+
+        while (!stack.empty()) {
+            auto [node, parent_edge] = stack.back();
+            stack.pop_back();
+
+            auto [copy_index, inserted] = to_table.try_emplace_index(node->key, *node);
+            Node* copy = &to_table.at(copy_index);
+            if (parent_edge)
+                parent_edge->child = copy_index;
+            // Transpositions are only copied once.
+            if (!inserted || node->n_actions == 0)
+                continue;
+
+            const auto node_children = all_children(node);
+            Edge* copied_edges = copy->inline_children.data();
+            // Inline children were copied along with their node.
+            if (!has_inline_children(node)) {
+                copy->first_child = to_edges.allocate(node_children.size());
+                copied_edges = to_edges.data(copy->first_child);
+                std::copy(node_children.begin(), node_children.end(), copied_edges);
+            }
+
+            order.clear();
+            for (size_t i = 0; i < node_children.size(); ++i) {
+                copied_edges[i].child = no_node;
+                const Node* child = MctsTree::child(&node_children[i]);
+                if (child && child->n_visits >= min_visits) {
+                    order.emplace_back(node_children[i].n_visits, i);
+                }
+            }
+            // The most visited child is pushed last, so that it is copied right after its parent.
+            std::ranges::sort(order);
+            for (const auto& [n_visits, i] : order) {
+                stack.emplace_back(MctsTree::child(&node_children[i]), &copied_edges[i]);
+            }
+        }
+
+        from_table.clear();
+        edges().clear();
+        m_active = to;
+        p_root = get_node(root_state.key());
+        m_compacted_size = size();
+    }
+
+    static bool has_inline_children(const Node* node)
+    {
+        return node->n_actions <= inline_capacity;
+    }
+    Edge* first_edge(const Node* node)
+    {
+        if (has_inline_children(node))
+            return const_cast<Node*>(node)->inline_children.data();
+
+        return edges().data(node->first_child);
+    }
+
+    /**
+     * The index of the node of the given key in the table, inserting it first if needed.
+     */
+    index_type get_node_index(const key_type key)
+    {
+        if (m_concurrent) {
+            {
+                std::shared_lock lock(m_mutex);
+                const index_type index = table().find_index(key);
+                if (index != no_node)
+                    return index;
+            }
+            std::unique_lock lock(m_mutex);
+            return insert(key);
+        }
+        return insert(key);
+    }
+
+    index_type insert(const key_type key)
+    {
+        return table().try_emplace_index(key, Node {
+                                                  .key = key,
+                                              })
+            .first;
+    }
+
     std::string display(const Edge&) const;
     std::string display(const Node&) const;
 };
@@ -163,9 +745,11 @@ template <
 MctsTree<StateT,
     ActionT,
     MAX_DEPTH>::MctsTree(key_type key)
-    : m_table()
-    , m_edge_stack {}
-    , m_depth {}
+    : m_tables()
+    , m_edges()
+    , m_active(0)
+    , m_mutex()
+    , m_concurrent(false)
     , p_root(get_node(key))
 {
 }
@@ -206,20 +790,21 @@ std::string MctsTree<StateT, ActionT, MAX_DEPTH>::display(
 template <typename StateT, typename ActionT, size_t MAX_DEPTH>
 std::ostream& operator<<(std::ostream& _out, const MctsTree<StateT, ActionT, MAX_DEPTH>& tree)
 {
-    for (const auto& [key, node] : tree.m_table) {
+    tree.table().for_each([&](const auto& node) {
+        const auto children = tree.children(&node);
         _out << "{\n"
              << tree.display(node)
              << "\"children\": [";
-        if (!node.children.empty()) {
-            for (auto it = node.children.begin();
-                 it != node.children.end() - 1;
+        if (!children.empty()) {
+            for (auto it = children.begin();
+                 it != children.end() - 1;
                  ++it) {
                 _out << tree.display(*it) << ", ";
             }
-            _out << tree.display(node.children.back());
+            _out << tree.display(children.back());
         }
         _out << "]\n},\n";
-    }
+    });
 
     return _out;
 }
@@ -2,10 +2,12 @@
 #define __MCTS_POLICIES_H_
 
 #include <cmath>
+#include <concepts>
 #include <functional>
 #include <iostream>
 #include <utility>
 
+#include "selection.h"
 
 
 namespace policies {
@@ -14,8 +16,17 @@ namespace policies {
  * A UCB functor is used in the MCTS algorithm to select which edge to traverse
  * when exploring the state/action tree. Until we land on an unexplored node,
  * we choose the edge maximizing the functor's operator().
+ *
+ * @Note Functors also providing `exploration_weight()` (see `mcts::selection::Has_exploration_weight`)
+ * are evaluated by the vectorized `mcts::selection::argmax_ucb()` instead.
  */
 struct Default_UCB_Func {
+    double exploration_weight(double expl_cst, unsigned int n_parent_visits) const
+    {
+        return expl_cst * mcts::selection::sqrt_log_visits(n_parent_visits);
+    }
+
+
     auto operator()(double expl_cst, unsigned int n_parent_visits)
     {
         return [expl_cst, n_parent_visits]<typename EdgeT>(const EdgeT& edge) {
@@ -39,6 +50,14 @@ struct Default_UCB_Func {
     }
 };
 
+/**
+ * A Playout functor plays one action on the state it references every time
+ * its operator() is called, and returns it.
+ *
+ * @Note Functors also providing `choose()`, returning the action to play without
+ * playing it, let the playouts evaluate and apply the actions on a single state
+ * instead of copying the state on every ply (see `Has_choose`).
+ */
 template <typename StateT, typename ActionT>
 struct Default_Playout_Func {
     Default_Playout_Func(StateT& _state)
@@ -51,9 +70,19 @@ struct Default_Playout_Func {
         return state.apply_random_action();
     }
 
+    ActionT choose() const
+        requires requires(const StateT& s) { s.random_action(); }
+    {
+        return state.random_action();
+    }
+
     StateT& state;
 };
 
+template <typename Playout_Functor, typename ActionT>
+concept Has_choose = requires(Playout_Functor& f) {
+    { f.choose() } -> std::convertible_to<ActionT>;
+};
 
 } // namespace policies
 
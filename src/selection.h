@@ -0,0 +1,166 @@
+#ifndef __SELECTION_H_
+#define __SELECTION_H_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <limits>
+#include <span>
+
+namespace mcts {
+namespace selection {
+
+/**
+ * Read a statistic of the tree which other searchers may be updating at the same
+ * time (see `MctsTree::set_concurrent()`).
+ *
+ * @Note A relaxed atomic load is a plain load on the usual targets, so the statistics
+ * are read this way whether the search is concurrent or not.
+ */
+template <typename T>
+T load(const T& stat)
+{
+    return std::atomic_ref<T>(const_cast<T&>(stat)).load(std::memory_order_relaxed);
+}
+
+/**
+ * Visit counts below this size have their logs and square roots read from a table.
+ */
+constexpr size_t table_size = 256;
+
+struct Visit_tables {
+    /** 1 / (n + 1) */
+    std::array<double, table_size> inv;
+    /** 1 / sqrt(n + 1) */
+    std::array<double, table_size> inv_sqrt;
+    /** sqrt(log(n)), 0 for n = 0 */
+    std::array<double, table_size> sqrt_log;
+
+    Visit_tables()
+    {
+        for (size_t n = 0; n < table_size; ++n) {
+            inv[n] = 1.0 / (n + 1.0);
+            inv_sqrt[n] = 1.0 / std::sqrt(n + 1.0);
+            sqrt_log[n] = n > 0 ? std::sqrt(std::log(double(n))) : 0.0;
+        }
+    }
+};
+
+inline const Visit_tables& visit_tables()
+{
+    static const Visit_tables tables;
+    return tables;
+}
+
+inline double inv_visits(int n)
+{
+    return size_t(n) < table_size ? visit_tables().inv[n] : 1.0 / (n + 1.0);
+}
+inline double inv_sqrt_visits(int n)
+{
+    return size_t(n) < table_size ? visit_tables().inv_sqrt[n] : 1.0 / std::sqrt(n + 1.0);
+}
+inline double sqrt_log_visits(unsigned int n)
+{
+    return n < table_size ? visit_tables().sqrt_log[n] : std::sqrt(std::log(double(n)));
+}
+
+/**
+ * A UCB functor whose value can be written as
+ *
+ *     total_val / (n_visits + 1) + exploration_weight(expl_cst, n_parent_visits) / sqrt(n_visits + 1)
+ *
+ * up to a constant, exposes the weight so that the selection can run `argmax_ucb()`
+ * instead of calling the functor on every edge.
+ */
+template <typename UCB_Functor>
+concept Has_exploration_weight = requires(const UCB_Functor& f, double expl_cst, unsigned int n) {
+    { f.exploration_weight(expl_cst, n) } -> std::convertible_to<double>;
+};
+
+/**
+ * Return the index of the first edge maximizing `score`, evaluating it once per edge.
+ */
+template <typename EdgeT, typename F>
+size_t argmax(std::span<EdgeT> edges, F&& score)
+{
+    size_t best = 0;
+    auto best_score = score(edges[0]);
+    for (size_t i = 1; i < edges.size(); ++i) {
+        auto s = score(edges[i]);
+        if (s > best_score) {
+            best = i;
+            best_score = s;
+        }
+    }
+    return best;
+}
+
+/**
+ * Return the index of the first edge maximizing
+ *
+ *     mean(edge) + weight / sqrt(n_visits + 1)
+ *
+ * The statistics of the edges are gathered in blocks of structure-of-arrays, so that
+ * the scores of a block are computed by a loop the compiler can vectorize.
+ *
+ * @Note With a weight of 0, this is the argmax of the means.
+ * @Note With `skip_completed`, the edges whose subtree is completed score -infinity,
+ * so the first edge is returned if they all are.
+ */
+template <typename EdgeT, typename Mean>
+size_t argmax_ucb(std::span<EdgeT> edges, double weight, bool skip_completed, Mean&& mean)
+{
+    constexpr size_t block_size = 32;
+    constexpr double skipped = -std::numeric_limits<double>::infinity();
+    alignas(64) std::array<double, block_size> mean_val;
+    alignas(64) std::array<double, block_size> inv_sqrt;
+    alignas(64) std::array<double, block_size> score;
+    alignas(64) std::array<bool, block_size> skip;
+
+    size_t best = 0;
+    double best_score = -std::numeric_limits<double>::infinity();
+
+    for (size_t start = 0; start < edges.size(); start += block_size) {
+        const size_t n = std::min(block_size, edges.size() - start);
+
+        for (size_t i = 0; i < n; ++i) {
+            const auto& edge = edges[start + i];
+            mean_val[i] = mean(edge);
+            inv_sqrt[i] = inv_sqrt_visits(load(edge.n_visits));
+            skip[i] = skip_completed && load(edge.subtree_completed);
+        }
+        for (size_t i = 0; i < n; ++i) {
+            score[i] = mean_val[i] + weight * inv_sqrt[i];
+            score[i] = skip[i] ? skipped : score[i];
+        }
+        for (size_t i = 0; i < n; ++i) {
+            if (score[i] > best_score) {
+                best = start + i;
+                best_score = score[i];
+            }
+        }
+    }
+    return best;
+}
+
+/**
+ * Same as above with the average value of the edges as their mean:
+ *
+ *     total_val / (n_visits + 1) + weight / sqrt(n_visits + 1)
+ */
+template <typename EdgeT>
+size_t argmax_ucb(std::span<EdgeT> edges, double weight, bool skip_completed = false)
+{
+    return argmax_ucb(edges, weight, skip_completed, [](const auto& edge) {
+        return load(edge.total_val) * inv_visits(load(edge.n_visits));
+    });
+}
+
+} // namespace selection
+} // namespace mcts
+
+#endif
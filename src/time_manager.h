@@ -0,0 +1,96 @@
+#ifndef __TIME_MANAGER_H_
+#define __TIME_MANAGER_H_
+
+#include <algorithm>
+
+namespace mcts {
+
+/**
+ * Split a game clock, a total time plus an increment per move, into per-move budgets
+ * (all in milliseconds).
+ *
+ * Every move gets its share of the remaining time over the expected number of moves
+ * left, plus most of the increment. The agent may stretch the search up to a maximum
+ * budget while its best move is unstable, and stops early once the best move can't
+ * change anymore (see `Config::max_time_stretch` and `Config::stop_when_decided`).
+ *
+ * Usage:
+ *
+ *     Time_manager tm(60000, 500);
+ *     tm.configure(agent);
+ *     auto action = agent.best_action();
+ *     tm.move_played(time_taken);
+ */
+class Time_manager {
+public:
+    struct Move_budget {
+        int optimum;
+        int maximum;
+    };
+
+    /**
+     * @Note `expected_n_moves` is the expected number of moves we play in a game.
+     */
+    Time_manager(int total_time, int increment = 0, int expected_n_moves = 40)
+        : m_remaining(total_time)
+        , m_increment(increment)
+        , m_expected_n_moves(expected_n_moves)
+    {
+    }
+
+    Move_budget next_move() const
+    {
+        const int moves_left = std::max(min_moves_left, m_expected_n_moves - m_n_moves);
+        // Keep a part of the clock for the overhead around the searches.
+        const int usable = m_remaining - m_remaining / reserve_divisor;
+
+        int optimum = usable / moves_left + 3 * m_increment / 4;
+        optimum = std::max(1, std::min(optimum, usable / 2));
+        int maximum = std::max(optimum, std::min(max_stretch * optimum, usable / 3));
+        return Move_budget { optimum, maximum };
+    }
+
+    /**
+     * Set the agent's time budget for the next move.
+     */
+    template <typename Agent>
+    void configure(Agent& agent) const
+    {
+        const auto budget = next_move();
+        agent.set_max_time(budget.optimum);
+        agent.set_max_time_stretch(budget.maximum);
+        agent.set_stop_when_decided(true);
+    }
+
+    /**
+     * Charge the time taken by our last move to the clock.
+     */
+    void move_played(int time_taken)
+    {
+        m_remaining = std::max(0, m_remaining - time_taken) + m_increment;
+        ++m_n_moves;
+    }
+
+    int remaining() const
+    {
+        return m_remaining;
+    }
+    int n_moves() const
+    {
+        return m_n_moves;
+    }
+
+private:
+    static constexpr int min_moves_left = 10;
+    static constexpr int reserve_divisor = 20;
+    static constexpr int max_stretch = 3;
+
+    int m_remaining;
+    int m_increment;
+    int m_expected_n_moves;
+    int m_n_moves = 0;
+};
+
+} // namespace mcts
+
+#endif
@@ -0,0 +1,285 @@
+#ifndef __TRANSPOSITION_TABLE_H_
+#define __TRANSPOSITION_TABLE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "utils/arena.h"
+
+namespace mcts {
+
+/**
+ * A hash table mapping the Zobrist keys of states to the nodes of the tree.
+ *
+ * The slots form a flat array probed linearly, and hold the index of the
+ * value in an arena that never moves its elements. So growing the table
+ * only rehashes the slots, and the pointers returned stay valid until
+ * the table is cleared.
+ *
+ * Slots are stamped with the generation of the table, so that clearing
+ * the table is O(1): bumping the generation empties all the slots.
+ */
+template <typename Key, typename Value>
+class TranspositionTable {
+public:
+    struct Probe_stats {
+        size_t n_lookups;
+        size_t n_probes;
+        size_t max_probe_length;
+
+        double avg_probe_length() const
+        {
+            return n_lookups > 0 ? double(n_probes) / n_lookups : 0.0;
+        }
+    };
+
+    /**
+     * The values are also referred to by their index, which stays valid as long
+     * as their address (see `at()`).
+     */
+    using index_type = typename ::utils::Arena<Value>::index_type;
+    static constexpr index_type no_index = std::numeric_limits<index_type>::max();
+
+    explicit TranspositionTable(size_t capacity = 0)
+    {
+        reserve(capacity);
+    }
+
+    /**
+     * Return a pointer to the value stored at `key`, or nullptr.
+     */
+    Value* find(const Key key) const
+    {
+        const index_type index = find_index(key);
+        return index == no_index ? nullptr : const_cast<Value*>(&at(index));
+    }
+
+    /**
+     * Same as `find()`, returning the index of the value or `no_index`.
+     */
+    index_type find_index(const Key key) const
+    {
+        if (m_slots.empty())
+            return no_index;
+
+        size_t n_probes = 1;
+        for (size_t i = bucket(key);; i = (i + 1) & m_mask, ++n_probes) {
+            const Slot& slot = m_slots[i];
+            if (!occupied(slot)) {
+                record_probes(n_probes);
+                return no_index;
+            }
+            if (slot.key == key) {
+                record_probes(n_probes);
+                return slot.index;
+            }
+        }
+    }
+
+    /**
+     * Return a pointer to the value stored at `key`, constructing it from
+     * `args` first if the key is not in the table yet.
+     *
+     * @Note The second member is true if the value was inserted.
+     */
+    template <typename... Args>
+    std::pair<Value*, bool> try_emplace(const Key key, Args&&... args)
+    {
+        auto [index, inserted] = try_emplace_index(key, std::forward<Args>(args)...);
+        return { &at(index), inserted };
+    }
+
+    /**
+     * Same as `try_emplace()`, returning the index of the value.
+     */
+    template <typename... Args>
+    std::pair<index_type, bool> try_emplace_index(const Key key, Args&&... args)
+    {
+        const size_t n_values = m_size.load(std::memory_order_relaxed);
+        if (n_values + 1 > max_size_before_growth()) {
+            rehash(std::max<size_t>(2 * m_slots.size(), min_capacity));
+        }
+
+        size_t n_probes = 1;
+        size_t i = bucket(key);
+        for (; occupied(m_slots[i]); i = (i + 1) & m_mask, ++n_probes) {
+            if (m_slots[i].key == key) {
+                record_probes(n_probes);
+                return { m_slots[i].index, false };
+            }
+        }
+        record_probes(n_probes);
+
+        index_type index = m_values.allocate(1);
+        new (m_values.data(index)) Value(std::forward<Args>(args)...);
+        m_slots[i] = Slot { key, index, m_generation };
+        m_size.store(n_values + 1, std::memory_order_relaxed);
+        return { index, true };
+    }
+
+    Value& at(index_type index)
+    {
+        return m_values[index];
+    }
+    const Value& at(index_type index) const
+    {
+        return m_values[index];
+    }
+
+    /**
+     * Size the table for `n` values, so that inserting them never rehashes.
+     */
+    void reserve(size_t n)
+    {
+        size_t capacity = min_capacity;
+        while (capacity * max_load_num < n * max_load_den) {
+            capacity *= 2;
+        }
+        if (capacity > m_slots.size()) {
+            rehash(capacity);
+        }
+    }
+
+    /**
+     * Release all the values at once.
+     */
+    void clear()
+    {
+        ++m_generation;
+        m_values.clear();
+        m_size.store(0, std::memory_order_relaxed);
+        reset_stats();
+    }
+
+    /**
+     * @Note The size can be read while another thread inserts a value, e.g. to
+     * check if the tree is full.
+     */
+    size_t size() const
+    {
+        return m_size.load(std::memory_order_relaxed);
+    }
+    size_t capacity() const
+    {
+        return m_slots.size();
+    }
+    double load_factor() const
+    {
+        return m_slots.empty() ? 0.0 : double(size()) / m_slots.size();
+    }
+
+    /**
+     * Statistics of the lookups since the construction or the last call to `reset_stats()`.
+     *
+     * @Note The counters are not synchronized, so they are only approximate
+     * when the table is probed from many threads.
+     */
+    Probe_stats probe_stats() const
+    {
+        return Probe_stats {
+            m_n_lookups.load(std::memory_order_relaxed),
+            m_n_probes.load(std::memory_order_relaxed),
+            m_max_probe_length.load(std::memory_order_relaxed)
+        };
+    }
+    void reset_stats()
+    {
+        m_n_lookups.store(0, std::memory_order_relaxed);
+        m_n_probes.store(0, std::memory_order_relaxed);
+        m_max_probe_length.store(0, std::memory_order_relaxed);
+    }
+
+    /**
+     * Apply `f` to all the values, in insertion order.
+     */
+    template <typename F>
+    void for_each(F&& f) const
+    {
+        for (size_t i = 0, n = size(); i < n; ++i) {
+            f(m_values[i]);
+        }
+    }
+    size_t bytes_reserved() const
+    {
+        return m_slots.size() * sizeof(Slot) + m_values.bytes_reserved();
+    }
+
+private:
+    struct Slot {
+        Key key;
+        index_type index;
+        uint32_t generation = 0;
+    };
+
+    static constexpr size_t min_capacity = 16;
+    // Grow when the table is more than 3/4 full.
+    static constexpr size_t max_load_num = 3;
+    static constexpr size_t max_load_den = 4;
+
+    std::vector<Slot> m_slots;
+    ::utils::Arena<Value> m_values;
+    uint32_t m_generation = 1;
+    size_t m_mask = 0;
+    size_t m_shift = 64;
+    std::atomic<size_t> m_size = 0;
+
+    mutable std::atomic<size_t> m_n_lookups = 0;
+    mutable std::atomic<size_t> m_n_probes = 0;
+    mutable std::atomic<size_t> m_max_probe_length = 0;
+
+    /**
+     * Fibonacci hashing: keep the high bits of the key times 2^64 / phi, so that
+     * keys which are not uniformly distributed (like small bitboards) spread
+     * over the whole table.
+     */
+    size_t bucket(const Key key) const
+    {
+        return (uint64_t(key) * 0x9E3779B97F4A7C15ull) >> m_shift;
+    }
+
+    bool occupied(const Slot& slot) const
+    {
+        return slot.generation == m_generation;
+    }
+
+    size_t max_size_before_growth() const
+    {
+        return m_slots.size() * max_load_num / max_load_den;
+    }
+
+    void rehash(size_t capacity)
+    {
+        std::vector<Slot> old_slots(capacity);
+        old_slots.swap(m_slots);
+        m_mask = capacity - 1;
+        m_shift = 64 - __builtin_ctzll(capacity);
+
+        for (const auto& slot : old_slots) {
+            if (!occupied(slot))
+                continue;
+            size_t i = bucket(slot.key);
+            while (occupied(m_slots[i])) {
+                i = (i + 1) & m_mask;
+            }
+            m_slots[i] = slot;
+        }
+    }
+
+    void record_probes(size_t n_probes) const
+    {
+        m_n_lookups.store(m_n_lookups.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        m_n_probes.store(m_n_probes.load(std::memory_order_relaxed) + n_probes, std::memory_order_relaxed);
+        if (n_probes > m_max_probe_length.load(std::memory_order_relaxed)) {
+            m_max_probe_length.store(n_probes, std::memory_order_relaxed);
+        }
+    }
+};
+
+} // namespace mcts
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef __ARENA_H_
+#define __ARENA_H_
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+
+namespace utils {
+
+/** The index of an element of an `Arena`. */
+using Arena_index = uint32_t;
+
+/**
+ * A bump allocator carving runs of contiguous elements out of large slabs.
+ *
+ * Elements are referred to by 32-bit indices, and the slabs never move so
+ * references stay valid until `clear()`. Since the elements are trivially
+ * destructible, `clear()` only rewinds the bump index and keeps the slabs
+ * around to be reused.
+ *
+ * The slabs are found through a two-level table whose blocks are added as the
+ * arena grows, so the arena can hold as many elements as its indices can refer to.
+ *
+ * @Note Growing the arena only writes entries of the table which were never read,
+ * so the elements already handed out can be read while another thread allocates
+ * (allocations must still be serialized by the caller).
+ */
+template <typename T, size_t SLAB_BITS = 14>
+class Arena {
+    static_assert(std::is_trivially_destructible_v<T>,
+        "Arena elements are released without running their destructors");
+
+public:
+    using index_type = Arena_index;
+    static constexpr size_t slab_size = size_t(1) << SLAB_BITS;
+    /**
+     * The number of elements the indices can refer to. The largest index is never
+     * handed out, so that it can stand for no element.
+     */
+    static constexpr size_t max_size = std::numeric_limits<index_type>::max();
+
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    /**
+     * Return the index of the first of `n` contiguous new elements.
+     *
+     * @Note The elements are left uninitialized.
+     * @Note Throw `std::length_error` if the indices would overflow.
+     */
+    index_type allocate(size_t n)
+    {
+        assert(n <= slab_size);
+
+        size_t offset = m_next & (slab_size - 1);
+        size_t first = offset + n > slab_size ? m_next + slab_size - offset : m_next;
+        if (first + n > max_size) {
+            throw std::length_error("utils::Arena: out of indices");
+        }
+        m_next = first;
+
+        size_t slab = m_next >> SLAB_BITS;
+        auto& block = m_blocks[slab >> block_bits];
+        if (!block) {
+            block = std::make_unique<std::unique_ptr<T[]>[]>(block_size);
+        }
+        auto& slab_data = block[slab & (block_size - 1)];
+        if (!slab_data) {
+            slab_data = std::make_unique_for_overwrite<T[]>(slab_size);
+            ++m_n_slabs;
+        }
+
+        index_type ret = m_next;
+        m_next += n;
+        return ret;
+    }
+
+    T& operator[](index_type i)
+    {
+        const size_t slab = i >> SLAB_BITS;
+        return m_blocks[slab >> block_bits][slab & (block_size - 1)][i & (slab_size - 1)];
+    }
+    const T& operator[](index_type i) const
+    {
+        return const_cast<Arena&>(*this)[i];
+    }
+    T* data(index_type i)
+    {
+        return &(*this)[i];
+    }
+
+    /**
+     * Release all the elements at once.
+     */
+    void clear()
+    {
+        m_next = 0;
+    }
+
+    /**
+     * One past the largest index handed out so far.
+     */
+    size_t size() const
+    {
+        return m_next;
+    }
+    size_t bytes_reserved() const
+    {
+        return m_n_slabs * slab_size * sizeof(T);
+    }
+
+private:
+    // Each block of the table holds the pointers to 2^block_bits slabs.
+    static constexpr size_t block_bits = 10;
+    static constexpr size_t block_size = size_t(1) << block_bits;
+    static constexpr size_t n_blocks = ((max_size >> SLAB_BITS) + block_size - 1) / block_size;
+
+    std::array<std::unique_ptr<std::unique_ptr<T[]>[]>, n_blocks> m_blocks;
+    size_t m_n_slabs = 0;
+    size_t m_next = 0;
+};
+
+} // namespace utils
+
+#endif
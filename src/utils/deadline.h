@@ -0,0 +1,91 @@
+#ifndef __DEADLINE_H_
+#define __DEADLINE_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+
+namespace utils {
+
+/**
+ * A time budget in microseconds, whose clock is only read every few calls to `expired()`.
+ *
+ * The number of calls between two reads of the clock adapts to the measured time
+ * between calls, so that the clock is read about every `max_check_interval`, and
+ * at least a few times in what remains of the budget, whatever the cost of the
+ * work done between the calls.
+ */
+class Deadline {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Duration = std::chrono::microseconds;
+
+    static constexpr std::chrono::nanoseconds max_check_interval = std::chrono::microseconds(50);
+    static constexpr size_t max_stride = 1 << 16;
+
+    Deadline()
+    {
+        reset_start();
+    }
+
+    void reset_start()
+    {
+        m_start = m_last_check = Clock::now();
+        m_n_calls = 0;
+        m_stride = 1;
+    }
+
+    /**
+     * Return true if `budget` has elapsed since the last `reset_start()`.
+     *
+     * @Note The budget may change from one call to the next, the stride
+     * is adapted to what remains of it.
+     */
+    bool expired(Duration budget)
+    {
+        if (++m_n_calls < m_stride) {
+            return false;
+        }
+
+        const auto now = Clock::now();
+        const auto remaining = m_start + budget - now;
+        if (remaining <= Clock::duration::zero()) {
+            return true;
+        }
+
+        // Read the clock again after about min(max_check_interval, remaining / 4),
+        // at the rate of the calls since the last read, growing the stride at most twofold.
+        const double ns_per_call = std::chrono::duration<double, std::nano>(now - m_last_check).count() / m_n_calls;
+        const double target_ns = std::chrono::duration<double, std::nano>(
+            std::min<Clock::duration>(max_check_interval, remaining / 4)).count();
+        const double stride = ns_per_call > 0.0 ? target_ns / ns_per_call : double(2 * m_stride);
+        m_stride = std::clamp<size_t>(size_t(stride), 1, std::min(2 * m_stride, max_stride));
+
+        m_n_calls = 0;
+        m_last_check = now;
+        return false;
+    }
+
+    Duration elapsed() const
+    {
+        return std::chrono::duration_cast<Duration>(Clock::now() - m_start);
+    }
+
+    /**
+     * The number of calls to `expired()` between two reads of the clock.
+     */
+    size_t stride() const
+    {
+        return m_stride;
+    }
+
+private:
+    Clock::time_point m_start;
+    Clock::time_point m_last_check;
+    size_t m_n_calls;
+    size_t m_stride;
+};
+
+} // namespace utils
+
+#endif
@@ -1,21 +1,28 @@
 #ifndef __STOPWATCH_H_
 #define __STOPWATCH_H_
 
+#include <algorithm>
 #include <chrono>
 #include <functional>
+#include <iterator>
 #include <vector>
 
 namespace utils {
 
 
-class Stopwatch {
+/**
+ * A stopwatch counting in the given resolution: `Stopwatch` counts milliseconds,
+ * and `Stopwatch_us` counts microseconds for budgets of a few milliseconds.
+ */
+template <typename Duration_T>
+class Basic_stopwatch {
 public:
     using Clock = std::chrono::steady_clock;
     using Time_point = Clock::time_point;
-    using Duration = std::chrono::milliseconds;
-    using Discrete_duration = Clock::rep;
+    using Duration = Duration_T;
+    using Discrete_duration = typename Duration::rep;
 
-    Stopwatch() :
+    Basic_stopwatch() :
         m_start(Clock::now()),
         m_stored_times(1, m_start)
     {
@@ -58,6 +65,9 @@ private:
     }
 };
 
+using Stopwatch = Basic_stopwatch<std::chrono::milliseconds>;
+using Stopwatch_us = Basic_stopwatch<std::chrono::microseconds>;
+
 } // namespace utils
 
 
@@ -0,0 +1,183 @@
+#ifndef __THREAD_POOL_H_
+#define __THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace utils {
+
+/**
+ * A fixed number of worker threads consuming a queue of tasks.
+ *
+ * The workers are spawned in the constructor and joined in the
+ * destructor, so that agents can keep a pool alive across searches
+ * instead of paying for thread creation on every move.
+ */
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t n_threads)
+        : m_done(false)
+        , m_batch_open(false)
+        , m_batch_generation(0)
+        , m_batch_workers(0)
+        , m_batch_size(0)
+        , m_batch_next(0)
+        , m_batch_completed(0)
+    {
+        m_workers.reserve(n_threads);
+        for (size_t i = 0; i < n_threads; ++i) {
+            m_workers.emplace_back([this, i] { work(i + 1); });
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_done = true;
+        }
+        m_cv.notify_all();
+        for (auto& worker : m_workers) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * Queue a task and return a future holding its result.
+     */
+    template <typename F>
+    std::future<std::invoke_result_t<F>> submit(F&& f)
+    {
+        using result_type = std::invoke_result_t<F>;
+        auto task = std::make_shared<std::packaged_task<result_type()>>(std::forward<F>(f));
+        std::future<result_type> ret = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_tasks.emplace_back([task] { (*task)(); });
+        }
+        m_cv.notify_one();
+        return ret;
+    }
+
+    /**
+     * Call `f(i, slot)` for every i in [0, n_tasks), on the idle workers and on the
+     * calling thread, and return once all the calls are done.
+     *
+     * `slot` identifies the thread running the call: 0 for the caller and 1, ..., size()
+     * for the workers, so `f` can index per-thread buffers with it.
+     *
+     * @Note Nothing is allocated, so this is cheap enough to fork small batches of
+     * work many times per second.
+     */
+    template <typename F>
+    void parallel_for(size_t n_tasks, F&& f)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_batch_fn = &call_batch<std::remove_reference_t<F>>;
+            m_batch_ctx = &f;
+            m_batch_size = n_tasks;
+            m_batch_next.store(0, std::memory_order_relaxed);
+            m_batch_completed.store(0, std::memory_order_relaxed);
+            m_batch_open = true;
+            ++m_batch_generation;
+        }
+        m_cv.notify_all();
+
+        run_batch(0);
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_batch_cv.wait(lock, [this] {
+            return m_batch_workers == 0
+                && m_batch_completed.load(std::memory_order_acquire) == m_batch_size;
+        });
+        m_batch_open = false;
+    }
+
+    size_t size() const
+    {
+        return m_workers.size();
+    }
+
+private:
+    std::vector<std::thread> m_workers;
+    std::deque<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_done;
+
+    // The batch of `parallel_for()`, type-erased so that it lives on the caller's stack.
+    std::condition_variable m_batch_cv;
+    bool m_batch_open;
+    size_t m_batch_generation;
+    size_t m_batch_workers;
+    size_t m_batch_size;
+    void (*m_batch_fn)(void*, size_t, size_t) = nullptr;
+    void* m_batch_ctx = nullptr;
+    std::atomic<size_t> m_batch_next;
+    std::atomic<size_t> m_batch_completed;
+
+    template <typename F>
+    static void call_batch(void* ctx, size_t i, size_t slot)
+    {
+        (*static_cast<F*>(ctx))(i, slot);
+    }
+
+    void run_batch(size_t slot)
+    {
+        size_t i;
+        while ((i = m_batch_next.fetch_add(1, std::memory_order_relaxed)) < m_batch_size) {
+            m_batch_fn(m_batch_ctx, i, slot);
+            m_batch_completed.fetch_add(1, std::memory_order_release);
+        }
+    }
+
+    void work(size_t slot)
+    {
+        size_t seen_generation = 0;
+
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cv.wait(lock, [this, seen_generation] {
+                    return m_done
+                        || !m_tasks.empty()
+                        || (m_batch_open && m_batch_generation != seen_generation);
+                });
+                if (m_batch_open && m_batch_generation != seen_generation) {
+                    seen_generation = m_batch_generation;
+                    ++m_batch_workers;
+                    lock.unlock();
+
+                    run_batch(slot);
+
+                    lock.lock();
+                    --m_batch_workers;
+                    m_batch_cv.notify_all();
+                    continue;
+                }
+                if (m_done && m_tasks.empty())
+                    return;
+                task = std::move(m_tasks.front());
+                m_tasks.pop_front();
+            }
+            task();
+        }
+    }
+};
+
+} // namespace utils
+
+#endif
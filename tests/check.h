@@ -0,0 +1,35 @@
+#ifndef __TESTS_CHECK_H_
+#define __TESTS_CHECK_H_
+
+#include <cstdlib>
+#include <iostream>
+
+namespace tests {
+
+inline int n_failures = 0;
+
+inline void check(bool ok, const char* expr, const char* file, int line)
+{
+    if (!ok) {
+        std::cerr << file << ':' << line << ": check failed: " << expr << std::endl;
+        ++n_failures;
+    }
+}
+
+/**
+ * The exit code of a test executable.
+ */
+inline int result()
+{
+    if (n_failures > 0) {
+        std::cerr << n_failures << " check(s) failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+} // namespace tests
+
+#define CHECK(cond) ::tests::check((cond), #cond, __FILE__, __LINE__)
+
+#endif
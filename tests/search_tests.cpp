@@ -0,0 +1,208 @@
+#include "mcts.h"
+#include "policies.h"
+#include "oware.h"
+#include "oware_mcts.h"
+#include "board.h"
+#include "tictactoe.h"
+
+#include <algorithm>
+#include <initializer_list>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "check.h"
+
+/**
+ * What the round trip through `apply_action()` and `undo_action()` must preserve.
+ */
+template <typename StateT>
+std::string snapshot(const StateT& state)
+{
+    std::stringstream ss;
+    ss << state << '\n'
+       << state.key() << ' '
+       << int(state.side_to_move()) << ' '
+       << state.is_terminal() << '\n';
+    for (const auto& action : state.valid_actions()) {
+        ss << action << ' ';
+    }
+    return ss.str();
+}
+
+/**
+ * Along random games, undoing every valid action must give back the position
+ * it was applied to.
+ */
+template <typename StateT>
+void test_undo_round_trip(int n_games)
+{
+    for (int game = 0; game < n_games; ++game) {
+        StateT state;
+        while (!state.is_terminal()) {
+            const std::string before = snapshot(state);
+            const auto actions = state.valid_actions();
+            for (const auto& action : actions) {
+                typename StateT::undo_type undo;
+                CHECK(state.apply_action(action, undo));
+                state.undo_action(action, undo);
+                CHECK(snapshot(state) == before);
+            }
+            state.apply_random_action();
+        }
+    }
+}
+
+/**
+ * With a state which can undo its actions, the best sequence must start from
+ * the root: its first action is the one `best_action()` plays after the same search.
+ *
+ * @Note Tic-tac-toe draws all its random actions from `ttt::rand_util`, so that
+ * seeding it makes the searches of both agents identical.
+ */
+void test_best_sequence_starts_at_root()
+{
+    using Agent = mcts::Mcts<ttt::State, ttt::State::action_type>;
+
+    for (unsigned seed = 0; seed < 5; ++seed) {
+        ttt::State state;
+        state.apply_action(ttt::Square(4));
+
+        ttt::rand_util = Rand::Util<uint8_t>(seed);
+        Agent sequence_agent(state);
+        sequence_agent.set_max_iterations(300);
+        sequence_agent.set_max_time(0);
+        const auto sequence = sequence_agent.best_action_sequence(Agent::ActionSelection::by_n_visits);
+
+        ttt::rand_util = Rand::Util<uint8_t>(seed);
+        Agent action_agent(state);
+        action_agent.set_max_iterations(300);
+        action_agent.set_max_time(0);
+        const auto action = action_agent.best_action(Agent::ActionSelection::by_n_visits);
+
+        CHECK(!sequence.empty());
+        CHECK(sequence.front() == action);
+    }
+}
+
+/**
+ * Past the explored part of the tree, the best sequence is completed with random
+ * actions until the end of the game, where Oware's random action is -1.
+ */
+void test_best_sequence_ends_the_game()
+{
+    using Agent = mcts::Mcts<Board, int, oware::TimeCutoff_UCB_Func<30>, oware::Oware_Playout_Func, 128>;
+
+    for (int search = 0; search < 5; ++search) {
+        Board state;
+        Agent agent(state);
+        // The root's children are not visited yet, so the sequence leaves the tree at once.
+        agent.set_max_iterations(1);
+        agent.set_max_time(0);
+
+        const auto sequence = agent.best_action_sequence(Agent::ActionSelection::by_n_visits);
+
+        for (const int action : sequence) {
+            CHECK(state.apply_action(action));
+        }
+        CHECK(state.is_terminal());
+    }
+}
+
+/**
+ * A search capped by `max_nodes` evicts nodes instead of growing the tree past the
+ * cap, and the root edges keep the visits of all the iterations.
+ */
+void test_eviction_keeps_root_visits()
+{
+    using Agent = mcts::Mcts<Board, int, oware::TimeCutoff_UCB_Func<30>, oware::Oware_Playout_Func, 128>;
+    const size_t max_nodes = 200;
+
+    Board state;
+    Agent agent(state);
+    agent.set_max_iterations(2000);
+    agent.set_max_time(0);
+    agent.set_max_nodes(max_nodes);
+
+    for (int move = 0; move < 5 && !state.is_terminal(); ++move) {
+        const int action = agent.best_action();
+
+        int n_root_visits = 0;
+        for (const auto& [value, n_visits] : agent.root_moves_eval()) {
+            n_root_visits += n_visits;
+        }
+        CHECK(agent.get_n_evicted() > 0);
+        CHECK(agent.get_n_nodes() <= max_nodes);
+        // Only the first iteration on a new tree doesn't go through a root edge, and
+        // the tree kept from the previous moves adds to the visits of this search.
+        CHECK(n_root_visits + 1 >= int(agent.get_iterations_cnt()));
+
+        agent.apply_root_action(action);
+        state.apply_action(action);
+    }
+}
+
+/**
+ * Play the given moves of tic-tac-toe from the empty board.
+ */
+ttt::State ttt_position(std::initializer_list<ttt::Square> moves)
+{
+    ttt::State state;
+    for (const auto move : moves) {
+        state.apply_action(move);
+    }
+    return state;
+}
+
+/**
+ * The solver proves a forced win and a forced loss of tic-tac-toe: the search stops
+ * with the root solved, a forced win is played by its only winning move, and the
+ * root edges of a forced loss all hold the proven value of a loss.
+ */
+void test_solver_proves_tictactoe()
+{
+    using ttt::Square;
+    using Agent = mcts::Mcts<ttt::State, ttt::State::action_type>;
+
+    // X to move: only B2 wins, by threatening both A3 and C3.
+    auto win = ttt_position({ Square::A1, Square::B1, Square::C1, Square::B3 });
+    // O to move: X threatens B1, C2 and B2 at once.
+    auto loss = ttt_position({ Square::A1, Square::A3, Square::C1, Square::B3, Square::C3 });
+
+    for (unsigned seed = 0; seed < 5; ++seed) {
+        ttt::rand_util = Rand::Util<uint8_t>(seed);
+        Agent win_agent(win);
+        win_agent.set_max_iterations(5000);
+        win_agent.set_max_time(0);
+        win_agent.set_solver(true);
+        const auto action = win_agent.best_action(Agent::ActionSelection::by_avg_value);
+
+        CHECK(win_agent.root_solved());
+        CHECK(win_agent.get_iterations_cnt() < 5000);
+        CHECK(action == Square::B2);
+
+        Agent loss_agent(loss);
+        loss_agent.set_max_iterations(5000);
+        loss_agent.set_max_time(0);
+        loss_agent.set_solver(true);
+        loss_agent.best_action();
+
+        CHECK(loss_agent.root_solved());
+        for (const auto& [value, n_visits] : loss_agent.root_moves_eval()) {
+            CHECK(value == 0.0);
+        }
+    }
+}
+
+int main()
+{
+    test_undo_round_trip<Board>(20);
+    test_undo_round_trip<ttt::State>(50);
+    test_undo_round_trip<BT::Position>(5);
+    test_best_sequence_starts_at_root();
+    test_best_sequence_ends_the_game();
+    test_eviction_keeps_root_visits();
+    test_solver_proves_tictactoe();
+
+    return tests::result();
+}
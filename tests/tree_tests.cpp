@@ -0,0 +1,163 @@
+#include "mcts_tree.h"
+#include "oware.h"
+#include "selection.h"
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <span>
+#include <vector>
+
+#include "check.h"
+
+using Tree = mcts::MctsTree<Board, Board::action_type, 128>;
+
+/**
+ * With bool players, the reward must be flipped exactly when the player of the
+ * edges changes (`~player` is always true for a bool).
+ */
+void test_backpropagate_flips_on_player_change()
+{
+    Tree tree(0);
+    Tree::Traversal traversal {};
+
+    // Two moves of `false` (e.g. an extra turn in Oware) followed by one of `true`.
+    const bool players[] = { false, false, true };
+    Tree::node_pointer node = tree.get_root();
+    for (size_t i = 0; i < 3; ++i) {
+        auto& edge = tree.allocate_children(node, 1)[0];
+        edge = {};
+        edge.action = int(i);
+        edge.player = players[i];
+        traversal.push(node, &edge);
+        node = tree.get_node(i + 1);
+    }
+    auto edges = traversal.edges;
+
+    tree.backpropagate<true>(traversal, 1.0, true);
+
+    CHECK(edges[2]->total_val == 1.0);
+    CHECK(edges[1]->total_val == 0.0);
+    CHECK(edges[0]->total_val == 0.0);
+}
+
+/**
+ * `copy_reachable()` keeps exactly the nodes reached through the `child` links
+ * from the root, and copies a transposition only once.
+ */
+void test_copy_reachable_keeps_linked_nodes()
+{
+    const Board root_state;
+    const auto actions = root_state.valid_actions();
+    Board a_state = root_state;
+    a_state.apply_action(actions[0]);
+    Board b_state = root_state;
+    b_state.apply_action(actions[1]);
+    Board c_state = a_state;
+    c_state.apply_action(a_state.valid_actions()[0]);
+    Board orphan_state = b_state;
+    orphan_state.apply_action(b_state.valid_actions()[0]);
+
+    // The root leads to A, B and A again, A leads to C, and nothing leads to the orphan.
+    Tree tree(root_state.key());
+    Tree::node_pointer a = tree.get_node(a_state.key());
+    tree.get_node(orphan_state.key());
+    auto root_edges = tree.allocate_children(tree.get_root(), 3);
+    for (auto& edge : root_edges)
+        edge = {};
+    tree.link(&root_edges[0], a_state.key());
+    tree.link(&root_edges[1], b_state.key());
+    tree.link(&root_edges[2], a_state.key());
+    auto& a_edge = tree.allocate_children(a, 1)[0];
+    a_edge = {};
+    tree.link(&a_edge, c_state.key());
+    CHECK(tree.size() == 5);
+
+    tree.compact(root_state);
+    CHECK(tree.size() == 4);
+    CHECK(tree.compacted_size() == tree.size());
+    const auto copied_edges = tree.children(tree.get_root());
+    CHECK(copied_edges.size() == 3);
+    CHECK(copied_edges[0].child == copied_edges[2].child);
+    CHECK(tree.child(&copied_edges[0])->key == a_state.key());
+
+    // Compacting again finds all the nodes reachable.
+    tree.compact(root_state);
+    CHECK(tree.size() == 4);
+
+    const auto [n_kept, n_freed] = tree.reroot(a_state);
+    CHECK(n_kept == 2);
+    CHECK(n_freed == 2);
+    CHECK(tree.size() == n_kept);
+    CHECK(tree.get_root()->key == a_state.key());
+}
+
+/**
+ * The arena grows past the 4096 slabs its table used to be limited to, and
+ * the elements keep their values.
+ */
+void test_arena_grows_past_the_first_slab_blocks()
+{
+    ::utils::Arena<int, 4> arena;
+    const size_t n = 5000 * arena.slab_size;
+    for (size_t i = 0; i < n; ++i) {
+        *arena.data(arena.allocate(1)) = int(i);
+    }
+
+    CHECK(arena.size() == n);
+    bool kept = true;
+    for (size_t i = 0; i < n; ++i) {
+        kept = kept && arena[i] == int(i);
+    }
+    CHECK(kept);
+}
+
+/**
+ * The blocked `argmax_ucb()` picks the same edge as a plain scalar argmax of the
+ * UCB scores, over random edges spanning several blocks and visit counts on both
+ * sides of the lookup tables.
+ */
+void test_argmax_ucb_matches_scalar_argmax()
+{
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<size_t> size_dist(1, 100);
+    std::uniform_int_distribution<int> visits_dist(0, 1000);
+    std::uniform_real_distribution<double> unit_dist(0.0, 1.0);
+    std::uniform_real_distribution<double> weight_dist(0.0, 2.0);
+
+    for (int trial = 0; trial < 1000; ++trial) {
+        std::vector<Tree::Edge> edges(size_dist(gen));
+        for (auto& edge : edges) {
+            edge.n_visits = visits_dist(gen);
+            edge.total_val = unit_dist(gen) * (edge.n_visits + 1);
+            edge.subtree_completed = unit_dist(gen) < 0.2;
+        }
+        const double weight = trial % 10 == 0 ? 0.0 : weight_dist(gen);
+        const bool skip_completed = trial % 2 == 0;
+
+        auto score = [&](const Tree::Edge& edge) {
+            if (skip_completed && edge.subtree_completed)
+                return -std::numeric_limits<double>::infinity();
+            return edge.total_val / (edge.n_visits + 1.0) + weight / std::sqrt(edge.n_visits + 1.0);
+        };
+        size_t expected = 0;
+        for (size_t i = 1; i < edges.size(); ++i) {
+            if (score(edges[i]) > score(edges[expected]))
+                expected = i;
+        }
+
+        const size_t best = mcts::selection::argmax_ucb(std::span(edges), weight, skip_completed);
+        // The tables may round the scores differently, which only matters for near ties.
+        CHECK(best == expected || std::abs(score(edges[best]) - score(edges[expected])) < 1e-12);
+    }
+}
+
+int main()
+{
+    test_backpropagate_flips_on_player_change();
+    test_copy_reachable_keeps_linked_nodes();
+    test_arena_grows_past_the_first_slab_blocks();
+    test_argmax_ucb_matches_scalar_argmax();
+
+    return tests::result();
+}